@@ -0,0 +1,83 @@
+/* Local stand-in for flex output (flex unavailable in sandbox). NOT COMMITTED. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../src/lexer.h"
+
+#include <assert.h>
+typedef struct { char *buf; size_t blen, bpos; char *text; size_t leng; int lineno; } st_t;
+
+static st_t *st_new(void) { st_t *S = calloc(1, sizeof(*S)); S->lineno = 1; return S; }
+int lexer_init(lexer_t *L, FILE *f) {
+    st_t *S = st_new(); L->scanner = S; L->column = 0;
+    size_t cap = 4096, n; S->buf = malloc(cap);
+    while ((n = fread(S->buf + S->blen, 1, cap - S->blen, f)) > 0) {
+        S->blen += n; if (S->blen == cap) { cap *= 2; S->buf = realloc(S->buf, cap); }
+    }
+    S->buf = realloc(S->buf, S->blen + 2); S->buf[S->blen] = 0; S->buf[S->blen+1] = 0;
+    return 0;
+}
+int lexer_init_str(lexer_t *L, const char *s) {
+    st_t *S = st_new(); L->scanner = S; L->column = 0;
+    S->blen = strlen(s); S->buf = malloc(S->blen + 2); memcpy(S->buf, s, S->blen + 1); S->buf[S->blen+1] = 0;
+    return 0;
+}
+void lexer_destroy(lexer_t *L) { st_t *S = L->scanner; free(S->buf); free(S->text); free(S); }
+const char *lexer_text(const lexer_t *L) { return ((st_t *)L->scanner)->text; }
+size_t lexer_len(const lexer_t *L) { return ((st_t *)L->scanner)->leng; }
+int lexer_line(const lexer_t *L) { return ((st_t *)L->scanner)->lineno; }
+int lexer_column(const lexer_t *L) { return L->column; }
+
+static void settext(st_t *S, lexer_t *L, size_t start, size_t len) {
+    free(S->text); S->text = malloc(len + 1); memcpy(S->text, S->buf + start, len); S->text[len] = 0;
+    S->leng = len; L->column += (int)len;
+    for (size_t i = 0; i < len; i++) if (S->text[i] == '\n') S->lineno++;
+}
+static int isop(char c) { return c && strchr("!#$%&*+./<=>?@\\^|-", c) != NULL; }
+static int isid(char c) { return isalnum((unsigned char)c) || c == '\''; }
+
+static const struct { const char *s; int t; } kws[] = {
+ {"case",TOK_CASE},{"class",TOK_CLASS},{"data",TOK_DATA},{"default",TOK_DEFAULT},{"deriving",TOK_DERIVING},
+ {"do",TOK_DO},{"else",TOK_ELSE},{"foreign",TOK_FOREIGN},{"if",TOK_IF},{"import",TOK_IMPORT},{"in",TOK_IN},
+ {"infix",TOK_INFIX},{"infixl",TOK_INFIXL},{"infixr",TOK_INFIXR},{"instance",TOK_INSTANCE},{"let",TOK_LET},
+ {"module",TOK_MODULE},{"newtype",TOK_NEWTYPE},{"of",TOK_OF},{"then",TOK_THEN},{"type",TOK_TYPE},{"where",TOK_WHERE}};
+static const struct { const char *s; int t; } puncs[] = {
+ {"()",TOK_UNIT},{"..",TOK_OP_RANGE},{"::",TOK_OP_HASTYPE},{"<-",TOK_OP_L_ARROW},{"->",TOK_OP_R_ARROW},{"=>",TOK_OP_R_FAT_ARROW},
+ {"(",'('},{")",')'},{",",','},{";",';'},{"[",'['},{"]",']'},{"`",'`'},{"{",'{'},{"}",'}'},{"_",'_'},{"~",'~'},{".",'.'},
+ {"-",'-'},{":",':'},{"=",'='},{"\\",'\\'},{"|",'|'},{"@",'@'}};
+
+static int yylex_inner(lexer_t *L) {
+    st_t *S = L->scanner;
+    for (;;) {
+        if (S->bpos >= S->blen) return 0;
+        size_t s = S->bpos; char c = S->buf[s];
+        if (c == '{' && S->buf[s+1] == '-') {
+            size_t e = s + 2;
+            while (e < S->blen && !(S->buf[e] == '-' && S->buf[e+1] == '}')) e++;
+            if (e < S->blen) e += 2;
+            settext(S, L, s, e - s); S->bpos = e; continue;
+        }
+        if (c == '-' && S->buf[s+1] == '-') { size_t e = s; while (e < S->blen && S->buf[e] != '\n') e++; settext(S, L, s, e - s); S->bpos = e; continue; }
+        if (c == ' ' || c == '\t') { size_t e = s; while (S->buf[e] == ' ' || S->buf[e] == '\t') e++; settext(S, L, s, e - s); S->bpos = e; continue; }
+        if (c == '\n' || (c == '\r' && S->buf[s+1] == '\n')) { size_t e = s + 1; if ((c == '\r' && S->buf[e] == '\n') || (c == '\n' && S->buf[e] == '\r')) e++; settext(S, L, s, e - s); S->bpos = e; L->column = 0; continue; }
+        if (isalpha((unsigned char)c)) {
+            size_t e = s; while (isid(S->buf[e])) e++;
+            settext(S, L, s, e - s); S->bpos = e;
+            if (islower((unsigned char)c)) { for (size_t i = 0; i < sizeof(kws)/sizeof(*kws); i++) if (!strcmp(kws[i].s, S->text)) return kws[i].t; return TOK_VARID; }
+            return TOK_CONID;
+        }
+        if (isdigit((unsigned char)c)) { size_t e = s; while (isdigit((unsigned char)S->buf[e])) e++; settext(S, L, s, e - s); S->bpos = e; return TOK_NUMBER; }
+        if (c == '"') { size_t e = s + 1; while (e < S->blen && S->buf[e] != '"') e++; if (e < S->blen) { e++; settext(S, L, s, e - s); S->bpos = e; return TOK_STRING; } }
+        size_t oe = s; while (isop(S->buf[oe])) oe++;
+        size_t pl = 0; int pt = 0;
+        for (size_t i = 0; i < sizeof(puncs)/sizeof(*puncs); i++) { size_t l = strlen(puncs[i].s); if (l > pl && !strncmp(S->buf + s, puncs[i].s, l)) { pl = l; pt = puncs[i].t; } }
+        if (oe - s > pl) { settext(S, L, s, oe - s); S->bpos = oe; return TOK_OP; }
+        if (pl) { settext(S, L, s, pl); S->bpos = s + pl; return pt; }
+        settext(S, L, s, 1); S->bpos = s + 1;
+        fprintf(stderr, "Parse error(%d, %d): '%s' not recognized", S->lineno, L->column, S->text);
+        return TOK_ERROR;
+    }
+}
+
+int lexer_next(lexer_t *L) { return yylex_inner(L); }
@@ -27,15 +27,7 @@ void ast_destroy(ast_t *node, const allocator_t *allocator) {
     case AST_MODULE: {
         ast_module_t *module = &node->module;
 
-        if (module->modid != NULL) {
-            FREE(module->modid);
-        }
-
-        for (int i = 0; i < module->exports.len; ++i) {
-            const ast_export_t *export = vector_get_ref(&module->exports, i);
-            FREE(export->exportid);
-        }
-        vector_destroy(&module->exports);
+        smallvec_destroy(&module->exports);
 
         ast_destroy(module->body, allocator);
         FREE(module->body);
@@ -68,7 +60,6 @@ void ast_destroy(ast_t *node, const allocator_t *allocator) {
     case AST_OP_APPL: {
         ast_op_appl_t *op_appl = &node->op_appl;
 
-        FREE(op_appl->op_name);
         ast_destroy(op_appl->lhs, allocator);
         FREE(op_appl->lhs);
         ast_destroy(op_appl->rhs, allocator);
@@ -112,47 +103,18 @@ void ast_destroy(ast_t *node, const allocator_t *allocator) {
 
         break;
     }
-    case AST_VAR: {
-        ast_var_t *var = &node->var;
-
-        FREE(var->name);
-
-        break;
-    }
-    case AST_CON: {
-        ast_con_t *con = &node->con;
-
-        FREE(con->name);
-
-        break;
-    }
-    case AST_LIT: {
-        ast_lit_t *lit = &node->lit;
-
-        if (lit->lit_type == AST_LIT_TYPE_STR) {
-            FREE(lit->str_lit);
-        }
-        break;
-    }
-    case AST_FIXITY_DECL: {
-        ast_fixity_decl_t *fixity_decl = &node->fixity_decl;
-
-        FREE(fixity_decl->op);
-
-        break;
-    }
+    case AST_VAR:
+    case AST_CON:
+    case AST_LIT:
+    case AST_FIXITY_DECL:
+        break; // Names are interned symbols, nothing to free
     case AST_FN_DECL: {
         ast_fn_decl_t *fn_decl = &node->fn_decl;
 
         ast_destroy(fn_decl->body, allocator);
         FREE(fn_decl->body);
 
-        for (int i = 0; i < fn_decl->vars.len; ++i) {
-            FREE(*(char **)vector_get_ref(&fn_decl->vars, i));
-        }
-        vector_destroy(&fn_decl->vars);
-
-        FREE(fn_decl->name);
+        smallvec_destroy(&fn_decl->vars);
 
         break;
     }
@@ -162,8 +124,6 @@ void ast_destroy(ast_t *node, const allocator_t *allocator) {
         ast_destroy(val_decl->body, allocator);
         FREE(val_decl->body);
 
-        FREE(val_decl->name);
-
         break;
     }
     case AST_HAS_TYPE_DECL: {
@@ -172,8 +132,6 @@ void ast_destroy(ast_t *node, const allocator_t *allocator) {
         ast_destroy(has_type_decl->type_exp, allocator);
         FREE(has_type_decl->type_exp);
 
-        FREE(has_type_decl->symbol_name);
-
         break;
     }
     default:
@@ -196,7 +154,8 @@ void ast_print_indent(const ast_t *node, FILE *fp, int indent) {
 
         fprintf(fp, "%*sMODULE {\n", indent, "");
         if (module->modid != NULL) {
-            fprintf(fp, "%*smodid = %s\n", indent + FINDENT, "", module->modid);
+            fprintf(fp, "%*smodid = %s\n", indent + FINDENT, "",
+                    module->modid->str);
         }
 
         if (module->exports.len) {
@@ -204,9 +163,9 @@ void ast_print_indent(const ast_t *node, FILE *fp, int indent) {
 
             for (int i = 0; i < module->exports.len; ++i) {
                 const ast_export_t *export =
-                    vector_get_ref(&module->exports, i);
+                    smallvec_get_ref(&module->exports, i);
                 fprintf(fp, (i + 1 < module->exports.len) ? "%s " : "%s]\n",
-                        export->exportid);
+                        export->exportid->str);
             }
         }
 
@@ -260,7 +219,7 @@ void ast_print_indent(const ast_t *node, FILE *fp, int indent) {
 
         fprintf(fp, "%*sOP_APPL {\n", indent, "");
         fprintf(fp, "%*sop_name = %s\n", indent + FINDENT, "",
-                node->op_appl.op_name);
+                node->op_appl.op_name->str);
 
         fprintf(fp, "%*slhs = {\n", indent + FINDENT, "");
         ast_print_indent(op_appl->lhs, fp, indent + INDENT);
@@ -322,10 +281,10 @@ void ast_print_indent(const ast_t *node, FILE *fp, int indent) {
         break;
     }
     case AST_VAR:
-        fprintf(fp, "%*sVAR { %s }", indent, "", node->var.name);
+        fprintf(fp, "%*sVAR { %s }", indent, "", node->var.name->str);
         break;
     case AST_CON:
-        fprintf(fp, "%*sCON { %s }", indent, "", node->con.name);
+        fprintf(fp, "%*sCON { %s }", indent, "", node->con.name->str);
         break;
     case AST_LIT: {
         const ast_lit_t *lit = &node->lit;
@@ -335,7 +294,8 @@ void ast_print_indent(const ast_t *node, FILE *fp, int indent) {
             fprintf(fp, "%*sLIT { number = %d }", indent, "", lit->int_lit);
             break;
         case AST_LIT_TYPE_STR:
-            fprintf(fp, "%*sLIT { string = %s }", indent, "", lit->str_lit);
+            fprintf(fp, "%*sLIT { string = %s }", indent, "",
+                    lit->str_lit->str);
             break;
         default:
             fprintf(fp, "%*sLIT { unknown }", indent, "");
@@ -346,18 +306,20 @@ void ast_print_indent(const ast_t *node, FILE *fp, int indent) {
     case AST_FIXITY_DECL:
         fprintf(fp, "%*sINFIX%c %d %s", indent, "",
                 node->fixity_decl.associativity, node->fixity_decl.fixity,
-                node->fixity_decl.op);
+                node->fixity_decl.op->str);
         break;
     case AST_FN_DECL: {
         const ast_fn_decl_t *fn_decl = &node->fn_decl;
 
         fprintf(fp, "%*sFN_DECL {\n", indent, "");
-        fprintf(fp, "%*sname = %s\n", indent + FINDENT, "", fn_decl->name);
+        fprintf(fp, "%*sname = %s\n", indent + FINDENT, "",
+                fn_decl->name->str);
 
         fprintf(fp, "%*sargs = [", indent + FINDENT, "");
         for (i = 0; i < fn_decl->vars.len; ++i) {
             fprintf(fp, (i + 1 < fn_decl->vars.len) ? "%s " : "%s]\n",
-                    *((char **)vector_get_ref(&fn_decl->vars, i)));
+                    (*(const symbol_t **)smallvec_get_ref(&fn_decl->vars, i))
+                        ->str);
         }
 
         fprintf(fp, "%*sbody = {\n", indent + FINDENT, "");
@@ -371,7 +333,8 @@ void ast_print_indent(const ast_t *node, FILE *fp, int indent) {
         const ast_val_decl_t *val_decl = &node->val_decl;
 
         fprintf(fp, "%*sVAL_DECL {\n", indent, "");
-        fprintf(fp, "%*sname = %s\n", indent + FINDENT, "", val_decl->name);
+        fprintf(fp, "%*sname = %s\n", indent + FINDENT, "",
+                val_decl->name->str);
 
         fprintf(fp, "%*svalue = {\n", indent + FINDENT, "");
         ast_print_indent(val_decl->body, fp, indent + INDENT);
@@ -385,7 +348,7 @@ void ast_print_indent(const ast_t *node, FILE *fp, int indent) {
 
         fprintf(fp, "%*sHAS_TYPE {\n", indent, "");
         fprintf(fp, "%*ssymbol_name = %s\n", indent + FINDENT, "",
-                has_type_decl->symbol_name);
+                has_type_decl->symbol_name->str);
         fprintf(fp, "%*stype = {\n", indent + FINDENT, "");
         ast_print_indent(has_type_decl->type_exp, fp, indent + INDENT);
         fprintf(fp, "\n%*s}\n", indent + FINDENT, "");
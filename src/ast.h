@@ -1,6 +1,8 @@
 #ifndef SCHC_AST_H_
 #define SCHC_AST_H_
 
+#include "data/smallvec.h"
+#include "data/symtab.h"
 #include "data/vector.h"
 
 #include <stdio.h>
@@ -44,13 +46,13 @@ void ast_print(const ast_t *node, FILE *fp);
 void ast_destroy(ast_t *node, const allocator_t *allocator);
 
 typedef struct ast_module_ {
-    char *modid;
-    vector_t /*ast_export_t*/ exports;
+    const symbol_t *modid;
+    smallvec_t /*ast_export_t*/ exports;
     ast_t *body;
 } ast_module_t;
 
 typedef struct ast_export_ {
-    char *exportid;
+    const symbol_t *exportid;
 } ast_export_t;
 
 typedef struct ast_body_ {
@@ -68,7 +70,7 @@ typedef struct ast_fn_appl_ {
 } ast_fn_appl_t;
 
 typedef struct ast_op_appl_ {
-    char *op_name;
+    const symbol_t *op_name;
     ast_t *lhs;
     ast_t *rhs;
 } ast_op_appl_t;
@@ -89,11 +91,11 @@ typedef struct ast_let_ {
 } ast_let_t;
 
 typedef struct ast_var_ {
-    char *name;
+    const symbol_t *name;
 } ast_var_t;
 
 typedef struct ast_con_ {
-    char *name;
+    const symbol_t *name;
 } ast_con_t;
 
 typedef enum ast_lit_type_ {
@@ -106,29 +108,29 @@ typedef struct ast_lit_ {
     ast_lit_type_t lit_type;
     union {
         int int_lit;
-        char *str_lit;
+        const symbol_t *str_lit;
     };
 } ast_lit_t;
 
 typedef struct ast_fixity_decl_ {
     char associativity;
     int fixity;
-    char *op;
+    const symbol_t *op;
 } ast_fixity_decl_t;
 
 typedef struct ast_fn_decl_ {
-    char *name;
-    vector_t /*char**/ vars;
+    const symbol_t *name;
+    smallvec_t /*const symbol_t**/ vars;
     ast_t *body;
 } ast_fn_decl_t;
 
 typedef struct ast_val_decl_ {
-    char *name;
+    const symbol_t *name;
     ast_t *body;
 } ast_val_decl_t;
 
 typedef struct ast_has_type_decl_ {
-    char *symbol_name;
+    const symbol_t *symbol_name;
     ast_t *type_exp;
 } ast_has_type_decl_t;
 
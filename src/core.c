@@ -3,16 +3,38 @@
 #include <assert.h>
 #include <inttypes.h>
 
+#include "data/idtable.h"
 #include "env.h"
 #include "util.h"
 
 #define INDENT 2
 #define FINDENT 2
 
+#define ALLOC(x) ALLOCATOR_ALLOC(allocator, (x))
 #define FREE(x) ALLOCATOR_FREE(allocator, (x))
 
+static core_id_t core_next_id;
+
 int core_print_indent(const core_expr_t *expr, FILE *fp, int indent,
-                      vector_t /* core_expr_t* */ *seen);
+                      bitset_t *seen);
+
+core_expr_t *core_alloc(allocator_t *allocator) {
+    assert(allocator != NULL);
+
+    core_expr_t *expr;
+    TRYCR(expr, ALLOC(sizeof(core_expr_t)), NULL, NULL);
+
+    expr->id = __atomic_fetch_add(&core_next_id, 1, __ATOMIC_RELAXED);
+    expr->name = NULL;
+    expr->form = CORE_NO_FORM;
+
+    return expr;
+}
+
+// Ids handed out so far, enough to size a side table for all current nodes
+core_id_t core_id_count() {
+    return __atomic_load_n(&core_next_id, __ATOMIC_RELAXED);
+}
 
 int core_print(const core_expr_t *expr, FILE *fp) {
     assert(expr != NULL);
@@ -20,13 +42,15 @@ int core_print(const core_expr_t *expr, FILE *fp) {
 
     int res;
 
-    vector_t seen;
-    TRY(res, vector_init(&seen, sizeof(const core_expr_t *)));
+    // Ids keep growing for the whole process, so the set starts small and
+    // grows to the ids of the nodes actually printed
+    bitset_t seen;
+    TRY(res, bitset_init(&seen, 0));
 
     TRY(res, core_print_indent(expr, fp, 0, &seen));
     TRYNEG(res, fprintf(fp, "\n"));
 
-    vector_destroy(&seen);
+    bitset_destroy(&seen);
 
     return res;
 }
@@ -79,7 +103,7 @@ void core_destroy(core_expr_t *expr, allocator_t *allocator) {
 }
 
 int core_print_indent(const core_expr_t *expr, FILE *fp, int indent,
-                      vector_t /* core_expr_t* */ *seen) {
+                      bitset_t *seen) {
     assert(expr != NULL);
     assert(fp != NULL);
     assert(indent >= 0);
@@ -87,20 +111,16 @@ int core_print_indent(const core_expr_t *expr, FILE *fp, int indent,
 
     int res = 0;
 
-    for (size_t i = 0; i < seen->len; ++i) {
-        const core_expr_t *s = *((const core_expr_t **)vector_get_ref(seen, i));
-
-        if (s == expr) {
-            if (expr->name != NULL) {
-                TRYNEG(res, fprintf(fp, "%s <loop>", expr->name));
-            }
-
-            return 0;
+    // seen holds the nodes on the path from the root
+    if (bitset_test(seen, expr->id)) {
+        if (expr->name != NULL) {
+            TRYNEG(res, fprintf(fp, "%s <loop>", expr->name));
         }
+
+        return 0;
     }
 
-    void *memres;
-    TRYCR(memres, vector_push_back(seen, &expr), NULL, -1);
+    TRY(res, bitset_set(seen, expr->id));
 
     if (expr->name != NULL) {
         TRYNEG(res, fprintf(fp, "%s := ", expr->name));
@@ -197,7 +217,7 @@ int core_print_indent(const core_expr_t *expr, FILE *fp, int indent,
         fprintf(fp, "Form #%d", expr->form);
     }
 
-    seen->len--;
+    bitset_unset(seen, expr->id);
 
     return res;
 }
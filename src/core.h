@@ -10,8 +10,14 @@
 
 typedef struct core_expr_ core_expr_t;
 
+// Every core_expr_t gets an id when allocated. Ids are dense and start at 0,
+// so passes can keep per node data in the side tables of data/idtable.h.
+typedef uint32_t core_id_t;
+
 #include "env.h"
 
+core_expr_t *core_alloc(allocator_t *allocator);
+core_id_t core_id_count();
 int core_print(const core_expr_t *expr, FILE *fp);
 void core_destroy(core_expr_t *expr, allocator_t *allocator);
 
@@ -67,6 +73,7 @@ typedef struct core_cond_ {
 } core_cond_t;
 
 struct core_expr_ {
+    core_id_t id;
     const char *name;
     core_expr_form_t form;
     union {
@@ -6,8 +6,6 @@
 #include "data/vector.h"
 #include "util.h"
 
-#define ALLOC(x) ALLOCATOR_ALLOC(env->allocator, (x))
-
 #define CGFAIL(fmt, ...)                                                       \
     fprintf(stderr, "Coregen FAIL(%s:%d): " fmt "\n", __FILE__, __LINE__,      \
             ##__VA_ARGS__);
@@ -55,7 +53,7 @@ int coregen_populate_env(const vector_t /* core_ast_t */ *decls, env_t *env) {
 
             core_expr_t new_expr;
 
-            new_expr.name = val_decl->name;
+            new_expr.name = val_decl->name->str;
 
             TRY(res, env_put_expr(env, val_decl->name, &new_expr));
 
@@ -66,7 +64,7 @@ int coregen_populate_env(const vector_t /* core_ast_t */ *decls, env_t *env) {
 
             core_expr_t new_expr;
 
-            new_expr.name = fn_decl->name;
+            new_expr.name = fn_decl->name->str;
 
             TRY(res, env_put_expr(env, fn_decl->name, &new_expr));
 
@@ -121,27 +119,24 @@ int coregen_generate_env(const vector_t /* core_ast_t */ *decls, env_t *env) {
             TRYCR(expr, env_get_expr(env, fn_decl->name), NULL, -1);
 
             expr->form = CORE_LAMBDA;
-            expr->name = fn_decl->name;
-            // TRYCR(expr->name, stralloc(fn_decl->name), NULL, -1);
+            expr->name = fn_decl->name->str;
             core_lambda_t *lambda = &expr->lambda;
 
-            TRY(res, env_init_with_allocator(&lambda->args, env->allocator));
-            lambda->args.upper_scope = env;
+            TRY(res, env_init_scope(&lambda->args, env));
 
             for (size_t i = 0; i < fn_decl->vars.len; ++i) {
-                const char *varname =
-                    *(const char **)vector_get_ref(&fn_decl->vars, i);
+                const symbol_t *varname =
+                    *(const symbol_t **)smallvec_get_ref(&fn_decl->vars, i);
 
                 core_expr_t var_expr;
 
-                var_expr.name = varname;
-                // TRYCR(var_expr.name, stralloc(varname), NULL, -1);
+                var_expr.name = varname->str;
                 var_expr.form = CORE_PLACEHOLDER;
 
                 TRY(res, env_put_expr(&lambda->args, varname, &var_expr));
             }
 
-            TRYCR(lambda->body, ALLOC(sizeof(core_expr_t)), NULL, -1);
+            TRYCR(lambda->body, core_alloc(env->allocator), NULL, -1);
 
             TRY(res, coregen_from_ast(fn_decl->body, &lambda->args,
                                       lambda->body));
@@ -187,7 +182,7 @@ int coregen_from_ast(const ast_t *ast, env_t *env, core_expr_t *expr) {
         expr->form = CORE_CONSTRUCTOR;
         core_constructor_t *constructor = &expr->constructor;
 
-        TRYCR(constructor->name, stralloc(con_ast->name), NULL, -1);
+        constructor->name = con_ast->name->str;
 
         break;
     }
@@ -198,12 +193,12 @@ int coregen_from_ast(const ast_t *ast, env_t *env, core_expr_t *expr) {
         core_appl_t *appl = &expr->appl;
 
         // TODO: Prealloc intrisics
-        TRYCR(appl->fn, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(appl->fn, core_alloc(env->allocator), NULL, -1);
         appl->fn->name = NULL;
         appl->fn->form = CORE_INTRINSIC;
         appl->fn->intrinsic.name = "neg";
 
-        TRYCR(appl->arg, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(appl->arg, core_alloc(env->allocator), NULL, -1);
         appl->arg->name = NULL;
         TRY(res, coregen_from_ast(neg_ast->expr, env, appl->arg));
 
@@ -215,11 +210,11 @@ int coregen_from_ast(const ast_t *ast, env_t *env, core_expr_t *expr) {
         expr->form = CORE_APPL;
         core_appl_t *appl = &expr->appl;
 
-        TRYCR(appl->fn, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(appl->fn, core_alloc(env->allocator), NULL, -1);
         appl->fn->name = NULL;
         TRY(res, coregen_from_ast(fn_appl_ast->fn, env, appl->fn));
 
-        TRYCR(appl->arg, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(appl->arg, core_alloc(env->allocator), NULL, -1);
         appl->arg->name = NULL;
         TRY(res, coregen_from_ast(fn_appl_ast->arg, env, appl->arg));
 
@@ -231,7 +226,7 @@ int coregen_from_ast(const ast_t *ast, env_t *env, core_expr_t *expr) {
         core_expr_t *op_expr = env_get_expr(env, op_appl_ast->op_name);
 
         if (op_expr == NULL) {
-            CGFAIL("Operator not found: \"%s\"", op_appl_ast->op_name);
+            CGFAIL("Operator not found: \"%s\"", op_appl_ast->op_name->str);
 
             fprintf(stderr, "Scope:\n");
             env_print_scope(env, 1, stderr);
@@ -242,21 +237,21 @@ int coregen_from_ast(const ast_t *ast, env_t *env, core_expr_t *expr) {
         expr->form = CORE_APPL;
         core_appl_t *appl = &expr->appl;
 
-        TRYCR(appl->fn, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(appl->fn, core_alloc(env->allocator), NULL, -1);
         appl->fn->name = NULL;
         appl->fn->form = CORE_APPL;
         core_appl_t *lhs_appl = &appl->fn->appl;
 
-        TRYCR(lhs_appl->fn, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(lhs_appl->fn, core_alloc(env->allocator), NULL, -1);
         lhs_appl->fn->name = NULL;
         lhs_appl->fn->form = CORE_INDIR;
         lhs_appl->fn->indir.target = op_expr;
 
-        TRYCR(lhs_appl->arg, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(lhs_appl->arg, core_alloc(env->allocator), NULL, -1);
         lhs_appl->arg->name = NULL;
         TRY(res, coregen_from_ast(op_appl_ast->lhs, env, lhs_appl->arg));
 
-        TRYCR(appl->arg, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(appl->arg, core_alloc(env->allocator), NULL, -1);
         appl->arg->name = NULL;
         TRY(res, coregen_from_ast(op_appl_ast->rhs, env, appl->arg));
 
@@ -265,19 +260,15 @@ int coregen_from_ast(const ast_t *ast, env_t *env, core_expr_t *expr) {
     case AST_LET: {
         const ast_let_t *let_ast = &ast->let;
 
-        env_t *let_env;
-        TRYCR(let_env, malloc(sizeof(env_t)), NULL, -1);
-        TRY(res, env_init_with_allocator(let_env, env->allocator));
-        let_env->upper_scope = env;
+        // The bindings shadow the enclosing ones in its own map until popped
+        TRY(res, env_push_scope(env));
 
-        TRY(res, coregen_populate_env(&let_ast->bindings, let_env));
-        TRY(res, coregen_generate_env(&let_ast->bindings, let_env));
+        TRY(res, coregen_populate_env(&let_ast->bindings, env));
+        TRY(res, coregen_generate_env(&let_ast->bindings, env));
 
-        TRY(res, coregen_from_ast(let_ast->body, let_env, expr));
+        TRY(res, coregen_from_ast(let_ast->body, env, expr));
 
-        let_env->upper_scope = NULL;
-        env_destroy(let_env);
-        free(let_env);
+        env_pop_scope(env);
 
         break;
     }
@@ -306,7 +297,7 @@ int coregen_from_ast(const ast_t *ast, env_t *env, core_expr_t *expr) {
         core_expr_t *var_expr = env_get_expr(env, var_ast->name);
 
         if (var_expr == NULL) {
-            CGFAIL("\"%s\" not found", var_ast->name);
+            CGFAIL("\"%s\" not found", var_ast->name->str);
             return -1;
         }
 
@@ -321,9 +312,9 @@ int coregen_from_ast(const ast_t *ast, env_t *env, core_expr_t *expr) {
         expr->form = CORE_COND;
         core_cond_t *cond = &expr->cond;
 
-        TRYCR(cond->cond, ALLOC(sizeof(core_expr_t)), NULL, -1);
-        TRYCR(cond->then_branch, ALLOC(sizeof(core_expr_t)), NULL, -1);
-        TRYCR(cond->else_branch, ALLOC(sizeof(core_expr_t)), NULL, -1);
+        TRYCR(cond->cond, core_alloc(env->allocator), NULL, -1);
+        TRYCR(cond->then_branch, core_alloc(env->allocator), NULL, -1);
+        TRYCR(cond->else_branch, core_alloc(env->allocator), NULL, -1);
 
         TRY(res, coregen_from_ast(if_ast->cond, env, cond->cond));
         TRY(res, coregen_from_ast(if_ast->then_branch, env, cond->then_branch));
@@ -0,0 +1,202 @@
+#include "allocstats.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "util.h"
+
+#define ALLOC(size) ALLOCATOR_ALLOC(stats->inner, (size))
+#define REALLOC(ptr, size) ALLOCATOR_REALLOC(stats->inner, (ptr), (size))
+#define FREE(mem) ALLOCATOR_FREE(stats->inner, (mem))
+
+// Every allocation is prefixed with its size so frees can be accounted for.
+// 16 bytes keep the alignment the inner allocator gives.
+typedef struct alloc_stats_header_ {
+    size_t size;
+    size_t pad;
+} alloc_stats_header_t;
+
+static inline int alloc_stats_bucket(size_t size) {
+    int bucket = 0;
+
+    while (bucket < ALLOC_STATS_BUCKETS - 1 && ((size_t)1 << bucket) < size) {
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static inline void alloc_stats_add_live(alloc_stats_t *stats, size_t size) {
+    alloc_phase_stats_t *phase = &stats->phases[stats->phase];
+
+    stats->live += size;
+
+    if (stats->live > stats->peak_live) {
+        stats->peak_live = stats->live;
+    }
+
+    if (stats->live > phase->peak_live) {
+        phase->peak_live = stats->live;
+    }
+}
+
+int alloc_stats_init(alloc_stats_t *stats, const char *name,
+                     allocator_t *inner) {
+    assert(stats != NULL);
+    assert(name != NULL);
+    assert(inner != NULL);
+
+    memset(stats, 0, sizeof(alloc_stats_t));
+
+    stats->name = name;
+    stats->inner = inner;
+
+    // Until a phase is set everything is counted here
+    stats->phases[0].name = "-";
+    stats->phases_len = 1;
+
+    return 0;
+}
+
+void alloc_stats_allocator(alloc_stats_t *stats, allocator_t *allocator) {
+    allocator->allocator_data = stats;
+    allocator->alloc = (void *)alloc_stats_alloc;
+    allocator->realloc = (void *)alloc_stats_realloc;
+    allocator->free = (void *)alloc_stats_free;
+}
+
+// Makes phase the current phase, going back to it if it was seen before
+int alloc_stats_phase(alloc_stats_t *stats, const char *phase) {
+    assert(stats != NULL);
+    assert(phase != NULL);
+
+    for (size_t i = 0; i < stats->phases_len; ++i) {
+        if (!strcmp(stats->phases[i].name, phase)) {
+            stats->phase = i;
+            return 0;
+        }
+    }
+
+    if (stats->phases_len == ALLOC_STATS_MAX_PHASES) {
+        return -1;
+    }
+
+    stats->phase = stats->phases_len++;
+    stats->phases[stats->phase].name = phase;
+    stats->phases[stats->phase].peak_live = stats->live;
+
+    return 0;
+}
+
+void *alloc_stats_alloc(alloc_stats_t *stats, size_t size) {
+    assert(stats != NULL);
+
+    alloc_stats_header_t *header;
+    TRYCR(header, ALLOC(sizeof(alloc_stats_header_t) + size), NULL, NULL);
+
+    header->size = size;
+
+    alloc_phase_stats_t *phase = &stats->phases[stats->phase];
+
+    phase->allocs++;
+    phase->bytes += size;
+    phase->histogram[alloc_stats_bucket(size)]++;
+    alloc_stats_add_live(stats, size);
+
+    return header + 1;
+}
+
+void *alloc_stats_realloc(alloc_stats_t *stats, void *ptr, size_t size) {
+    assert(stats != NULL);
+
+    if (ptr == NULL) {
+        return alloc_stats_alloc(stats, size);
+    }
+
+    alloc_stats_header_t *header = (alloc_stats_header_t *)ptr - 1;
+    size_t old_size = header->size;
+
+    alloc_stats_header_t *new_header;
+    TRYCR(new_header, REALLOC(header, sizeof(alloc_stats_header_t) + size),
+          NULL, NULL);
+
+    new_header->size = size;
+
+    alloc_phase_stats_t *phase = &stats->phases[stats->phase];
+
+    phase->reallocs++;
+    phase->bytes += size;
+    phase->histogram[alloc_stats_bucket(size)]++;
+
+    if (new_header != header) {
+        phase->realloc_moves++;
+    }
+
+    stats->live -= old_size;
+    alloc_stats_add_live(stats, size);
+
+    return new_header + 1;
+}
+
+void alloc_stats_free(alloc_stats_t *stats, void *mem) {
+    assert(stats != NULL);
+
+    if (mem == NULL) {
+        return;
+    }
+
+    alloc_stats_header_t *header = (alloc_stats_header_t *)mem - 1;
+
+    stats->phases[stats->phase].frees++;
+    stats->live -= header->size;
+
+    FREE(header);
+}
+
+void alloc_stats_print(const alloc_stats_t *stats, FILE *fp) {
+    assert(stats != NULL);
+    assert(fp != NULL);
+
+    fprintf(fp, "%s: peak live %zu bytes, live at exit %zu bytes\n",
+            stats->name, stats->peak_live, stats->live);
+    fprintf(fp, "  %-12s %10s %10s %10s %10s %12s %12s\n", "phase", "allocs",
+            "reallocs", "moved", "frees", "bytes", "peak live");
+
+    for (size_t i = 0; i < stats->phases_len; ++i) {
+        const alloc_phase_stats_t *phase = &stats->phases[i];
+
+        if (phase->allocs + phase->reallocs + phase->frees == 0) {
+            continue;
+        }
+
+        fprintf(fp, "  %-12s %10zu %10zu %10zu %10zu %12zu %12zu\n",
+                phase->name, phase->allocs, phase->reallocs,
+                phase->realloc_moves, phase->frees, phase->bytes,
+                phase->peak_live);
+    }
+
+    for (size_t i = 0; i < stats->phases_len; ++i) {
+        const alloc_phase_stats_t *phase = &stats->phases[i];
+
+        if (phase->allocs + phase->reallocs == 0) {
+            continue;
+        }
+
+        fprintf(fp, "  %s sizes:", phase->name);
+
+        for (int bucket = 0; bucket < ALLOC_STATS_BUCKETS; ++bucket) {
+            if (phase->histogram[bucket] == 0) {
+                continue;
+            }
+
+            fprintf(fp, " %s%zu:%zu",
+                    bucket == ALLOC_STATS_BUCKETS - 1 ? ">" : "<=",
+                    (size_t)1 << (bucket == ALLOC_STATS_BUCKETS - 1
+                                      ? bucket - 1
+                                      : bucket),
+                    phase->histogram[bucket]);
+        }
+
+        fputc('\n', fp);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef SCHC_DATA_ALLOCSTATS_H_
+#define SCHC_DATA_ALLOCSTATS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+
+#define ALLOC_STATS_MAX_PHASES 8
+// Histogram buckets are powers of two, the last one holds everything bigger
+#define ALLOC_STATS_BUCKETS 16
+
+typedef struct alloc_phase_stats_ {
+    const char *name;
+    size_t allocs;
+    size_t reallocs;
+    size_t realloc_moves; // Reallocs that had to copy to a new address
+    size_t frees;
+    size_t bytes; // Bytes requested by allocs and reallocs
+    size_t peak_live;
+    size_t histogram[ALLOC_STATS_BUCKETS];
+} alloc_phase_stats_t;
+
+// Allocator decorator that forwards to inner and counts what goes through it.
+// Counts go to the current phase, set with alloc_stats_phase.
+typedef struct alloc_stats_ {
+    const char *name;
+    allocator_t *inner;
+    size_t live;
+    size_t peak_live;
+    size_t phase;
+    size_t phases_len;
+    alloc_phase_stats_t phases[ALLOC_STATS_MAX_PHASES];
+} alloc_stats_t;
+
+int alloc_stats_init(alloc_stats_t *stats, const char *name,
+                     allocator_t *inner);
+
+void alloc_stats_allocator(alloc_stats_t *stats, allocator_t *allocator);
+int alloc_stats_phase(alloc_stats_t *stats, const char *phase);
+
+void *alloc_stats_alloc(alloc_stats_t *stats, size_t size);
+void *alloc_stats_realloc(alloc_stats_t *stats, void *ptr, size_t size);
+void alloc_stats_free(alloc_stats_t *stats, void *mem);
+
+void alloc_stats_print(const alloc_stats_t *stats, FILE *fp);
+
+#endif /*SCHC_DATA_ALLOCSTATS_H_*/
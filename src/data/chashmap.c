@@ -0,0 +1,350 @@
+#include "chashmap.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <util.h>
+
+#define CHASHMAP_MIN_CAP 16
+
+// Key of a free slot closed by a migration. Lookups treat it as the end of
+// the probe in this table and puts go on in the next one.
+#define CHASHMAP_MOVED ((const symbol_t *)1)
+// Low bit of a value that was migrated out of its slot
+#define CHASHMAP_FROZEN ((uintptr_t)1)
+
+#define ALLOC(size) ALLOCATOR_ALLOC(chashmap->allocator, (size))
+#define FREE(mem) ALLOCATOR_FREE(chashmap->allocator, (mem))
+
+#define LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define CAS(ptr, expected, desired)                                            \
+    __atomic_compare_exchange_n((ptr), (expected), (desired), 0,               \
+                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+chashmap_table_t *chashmap_table_new(chashmap_t *chashmap, size_t cap);
+int chashmap_table_put(chashmap_t *chashmap, chashmap_table_t *table,
+                       const symbol_t *key, void *value, int if_absent);
+int chashmap_try_put(chashmap_t *chashmap, chashmap_table_t *table,
+                     const symbol_t *key, void *value, int if_absent);
+int chashmap_grow(chashmap_t *chashmap, chashmap_table_t *table);
+int chashmap_migrate_slot(chashmap_t *chashmap, chashmap_table_t *table,
+                          chashmap_slot_t *slot);
+int chashmap_migrate_key(chashmap_t *chashmap, chashmap_table_t *table,
+                         const symbol_t *key);
+int chashmap_help_migrate(chashmap_t *chashmap, chashmap_table_t *table);
+void chashmap_promote(chashmap_t *chashmap);
+
+static inline int chashmap_is_frozen(const void *value) {
+    return (uintptr_t)value & CHASHMAP_FROZEN;
+}
+
+static inline void *chashmap_unfreeze(const void *value) {
+    return (void *)((uintptr_t)value & ~CHASHMAP_FROZEN);
+}
+
+static inline size_t chashmap_home(const chashmap_table_t *table, uint64_t h) {
+    return h >> (64 - table->cap_pow);
+}
+
+int chashmap_init(chashmap_t *chashmap, size_t initial_capacity) {
+    return chashmap_init_with_allocator(chashmap, initial_capacity,
+                                        &default_allocator);
+}
+
+int chashmap_init_with_allocator(chashmap_t *chashmap, size_t initial_capacity,
+                                 allocator_t *allocator) {
+    assert(chashmap != NULL);
+    assert(allocator != NULL);
+
+    size_t cap = CHASHMAP_MIN_CAP;
+    while (cap < initial_capacity) {
+        cap *= 2;
+    }
+
+    chashmap->allocator = allocator;
+    TRYCR(chashmap->first, chashmap_table_new(chashmap, cap), NULL, -1);
+    chashmap->table = chashmap->first;
+
+    return 0;
+}
+
+void chashmap_destroy(chashmap_t *chashmap) {
+    assert(chashmap != NULL);
+
+    chashmap_table_t *table = chashmap->first;
+
+    while (table != NULL) {
+        chashmap_table_t *next = table->next;
+        FREE(table);
+        table = next;
+    }
+}
+
+chashmap_table_t *chashmap_table_new(chashmap_t *chashmap, size_t cap) {
+    chashmap_table_t *table;
+
+    TRYCR(table,
+          ALLOC(sizeof(chashmap_table_t) + cap * sizeof(chashmap_slot_t)),
+          NULL, NULL);
+    memset(table->slots, 0, cap * sizeof(chashmap_slot_t));
+
+    table->cap = cap;
+    table->cap_pow = __builtin_ctzll(cap);
+    table->len = 0;
+    table->next = NULL;
+    table->migrate_index = 0;
+    table->migrated = 0;
+
+    return table;
+}
+
+// Lookups
+//
+// A key is probed for in the newest migrated table first and then in the
+// tables it is being migrated to. A live value is always the newest one. A
+// frozen value was copied, or is being copied, to the next table where a put
+// may have replaced it since, so it only is the answer if the later tables
+// have no value for the key yet.
+
+void *chashmap_get_sym(const chashmap_t *chashmap, const symbol_t *key) {
+    assert(chashmap != NULL);
+    assert(key != NULL);
+
+    void *frozen = NULL;
+
+    for (const chashmap_table_t *table = LOAD(&chashmap->table); table != NULL;
+         table = LOAD(&table->next)) {
+        size_t mask = table->cap - 1;
+        size_t i = chashmap_home(table, key->hash);
+
+        for (size_t probes = 0; probes < table->cap; ++probes) {
+            const chashmap_slot_t *slot = &table->slots[i];
+            const symbol_t *slot_key = LOAD(&slot->key);
+
+            if (slot_key == key) {
+                void *value = LOAD(&slot->value);
+
+                if (!chashmap_is_frozen(value)) {
+                    return value != NULL ? value : frozen;
+                }
+
+                if (chashmap_unfreeze(value) != NULL) {
+                    frozen = chashmap_unfreeze(value);
+                }
+
+                break;
+            }
+
+            if (slot_key == NULL || slot_key == CHASHMAP_MOVED) {
+                break;
+            }
+
+            i = (i + 1) & mask;
+        }
+    }
+
+    return frozen;
+}
+
+// Puts
+//
+// Before a put moves on to the next table it migrates the slot of its key,
+// so the value it writes there can never be overwritten by an older copy.
+
+int chashmap_put_sym(chashmap_t *chashmap, const symbol_t *key, void *value) {
+    assert(chashmap != NULL);
+    assert(key != NULL);
+    assert(value != NULL);
+    assert(!chashmap_is_frozen(value));
+
+    return chashmap_table_put(chashmap, LOAD(&chashmap->table), key, value, 0);
+}
+
+int chashmap_table_put(chashmap_t *chashmap, chashmap_table_t *table,
+                       const symbol_t *key, void *value, int if_absent) {
+    int res;
+
+    for (;;) {
+        chashmap_table_t *next = LOAD(&table->next);
+
+        if (next != NULL) {
+            TRY(res, chashmap_migrate_key(chashmap, table, key));
+            TRY(res, chashmap_help_migrate(chashmap, table));
+
+            table = next;
+            continue;
+        }
+
+        TRY(res, chashmap_try_put(chashmap, table, key, value, if_absent));
+        if (res == 0) {
+            return 0;
+        }
+
+        // The table is full or being migrated
+        TRY(res, chashmap_grow(chashmap, table));
+    }
+}
+
+// Returns 1 if the put has to go to the next table
+int chashmap_try_put(chashmap_t *chashmap, chashmap_table_t *table,
+                     const symbol_t *key, void *value, int if_absent) {
+    int res;
+    size_t mask = table->cap - 1;
+    size_t i = chashmap_home(table, key->hash);
+
+    for (size_t probes = 0; probes < table->cap; ++probes) {
+        chashmap_slot_t *slot = &table->slots[i];
+        const symbol_t *slot_key = LOAD(&slot->key);
+
+        if (slot_key == NULL) {
+            if (CAS(&slot->key, &slot_key, key)) {
+                slot_key = key;
+
+                size_t len =
+                    __atomic_add_fetch(&table->len, 1, __ATOMIC_RELAXED);
+                if (len > table->cap / 4 * 3) {
+                    TRY(res, chashmap_grow(chashmap, table));
+                }
+            }
+        }
+
+        if (slot_key == CHASHMAP_MOVED) {
+            return 1;
+        }
+
+        if (slot_key == key) {
+            void *old = LOAD(&slot->value);
+
+            do {
+                if (chashmap_is_frozen(old)) {
+                    return 1;
+                }
+                if (if_absent && old != NULL) {
+                    return 0;
+                }
+            } while (!CAS(&slot->value, &old, value));
+
+            return 0;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return 1;
+}
+
+int chashmap_grow(chashmap_t *chashmap, chashmap_table_t *table) {
+    if (LOAD(&table->next) != NULL) {
+        return 0;
+    }
+
+    chashmap_table_t *next, *expected = NULL;
+    TRYCR(next, chashmap_table_new(chashmap, table->cap * 2), NULL, -1);
+
+    if (!CAS(&table->next, &expected, next)) {
+        FREE(next); // Another thread got there first
+    }
+
+    return 0;
+}
+
+// Migration
+
+// Closes a free slot, or freezes a used one and copies its value over
+int chashmap_migrate_slot(chashmap_t *chashmap, chashmap_table_t *table,
+                          chashmap_slot_t *slot) {
+    const symbol_t *key = LOAD(&slot->key);
+
+    while (key == NULL) {
+        if (CAS(&slot->key, &key, CHASHMAP_MOVED)) {
+            return 0;
+        }
+    }
+
+    if (key == CHASHMAP_MOVED) {
+        return 0;
+    }
+
+    void *value = LOAD(&slot->value);
+
+    while (!chashmap_is_frozen(value)) {
+        if (CAS(&slot->value, &value,
+                (void *)((uintptr_t)value | CHASHMAP_FROZEN))) {
+            break;
+        }
+    }
+
+    // Every thread that sees the slot frozen copies it, so it is in the next
+    // table by the time any of them writes there
+    value = chashmap_unfreeze(value);
+    if (value == NULL) {
+        return 0;
+    }
+
+    return chashmap_table_put(chashmap, LOAD(&table->next), key, value, 1);
+}
+
+int chashmap_migrate_key(chashmap_t *chashmap, chashmap_table_t *table,
+                         const symbol_t *key) {
+    size_t mask = table->cap - 1;
+    size_t i = chashmap_home(table, key->hash);
+
+    for (size_t probes = 0; probes < table->cap; ++probes) {
+        chashmap_slot_t *slot = &table->slots[i];
+        const symbol_t *slot_key = LOAD(&slot->key);
+
+        // A free slot ends the probe, closing it keeps late puts out
+        if (slot_key == key || slot_key == NULL) {
+            return chashmap_migrate_slot(chashmap, table, slot);
+        }
+
+        if (slot_key == CHASHMAP_MOVED) {
+            return 0;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return 0;
+}
+
+int chashmap_help_migrate(chashmap_t *chashmap, chashmap_table_t *table) {
+    int res;
+    size_t start = __atomic_fetch_add(&table->migrate_index,
+                                      CHASHMAP_MIGRATE_CHUNK, __ATOMIC_RELAXED);
+
+    if (start >= table->cap) {
+        return 0;
+    }
+
+    size_t end = start + CHASHMAP_MIGRATE_CHUNK;
+    if (end > table->cap) {
+        end = table->cap;
+    }
+
+    for (size_t i = start; i < end; ++i) {
+        TRY(res, chashmap_migrate_slot(chashmap, table, &table->slots[i]));
+    }
+
+    if (__atomic_add_fetch(&table->migrated, end - start, __ATOMIC_ACQ_REL) ==
+        table->cap) {
+        chashmap_promote(chashmap);
+    }
+
+    return 0;
+}
+
+// Moves chashmap->table past all tables that are fully migrated. Tables can
+// finish out of order, so this keeps going until it finds one still in use.
+void chashmap_promote(chashmap_t *chashmap) {
+    chashmap_table_t *table = LOAD(&chashmap->table);
+
+    while (LOAD(&table->next) != NULL &&
+           LOAD(&table->migrated) == table->cap) {
+        chashmap_table_t *expected = table;
+
+        CAS(&chashmap->table, &expected, table->next);
+        table = LOAD(&chashmap->table);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SCHC_DATA_CHASHMAP_H_
+#define SCHC_DATA_CHASHMAP_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "symtab.h"
+
+// Slots are migrated to a grown table this many at a time
+#define CHASHMAP_MIGRATE_CHUNK 256
+
+typedef struct chashmap_slot_ {
+    const symbol_t *key;
+    void *value;
+} chashmap_slot_t;
+
+typedef struct chashmap_table_ {
+    size_t cap;
+    int cap_pow;
+    size_t len;                   // Claimed slots
+    struct chashmap_table_ *next; // Table being migrated to, if growing
+    size_t migrate_index;         // Next chunk to migrate
+    size_t migrated;              // Slots migrated so far
+    chashmap_slot_t slots[];
+} chashmap_table_t;
+
+// Open addressing map from symbols to pointers that many threads can use at
+// once. Lookups take no locks and never wait, puts claim slots with CAS.
+//
+// A full table gets a twice as large next table. Every thread that puts
+// while the old table is still linked helps to move a chunk of it over.
+// Moved slots are frozen in the old table and lookups that hit one continue
+// in the next table. Old tables stay allocated until chashmap_destroy, as a
+// reader may still be probing them.
+//
+// Values must be non-NULL and at least 2 byte aligned, as the low bit marks
+// frozen slots. The allocator must be thread safe.
+typedef struct chashmap_ {
+    allocator_t *allocator;
+    chashmap_table_t *first; // Oldest table, the rest is reachable from it
+    chashmap_table_t *table; // Newest fully migrated table
+} chashmap_t;
+
+int chashmap_init(chashmap_t *chashmap, size_t initial_capacity);
+int chashmap_init_with_allocator(chashmap_t *chashmap, size_t initial_capacity,
+                                 allocator_t *allocator);
+void chashmap_destroy(chashmap_t *chashmap);
+
+int chashmap_put_sym(chashmap_t *chashmap, const symbol_t *key, void *value);
+void *chashmap_get_sym(const chashmap_t *chashmap, const symbol_t *key);
+
+#endif /*SCHC_DATA_CHASHMAP_H_*/
@@ -0,0 +1,346 @@
+#include "hamt.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <data/vector.h>
+#include <util.h>
+
+#define HAMT_MASK (HAMT_WIDTH - 1)
+
+#define ALLOC(size) ALLOCATOR_ALLOC(hamt->allocator, (size))
+#define FREE(mem) ALLOCATOR_FREE(hamt->allocator, (mem))
+
+// Leaves whose keys have the same full hash are chained, newest first
+typedef struct hamt_leaf_ {
+    const symbol_t *key;
+    void *value;
+    uint64_t owner; // id of the map that put it
+    struct hamt_leaf_ *next;
+} hamt_leaf_t;
+
+// Only the children present in bitmap are stored, in slot order. Those also
+// present in leafmap are leaf chains, the others are nodes one level down.
+typedef struct hamt_node_ {
+    uint32_t bitmap;
+    uint32_t leafmap;
+    void *children[];
+} hamt_node_t;
+
+static uint64_t hamt_next_id;
+
+void *hamt_track(hamt_t *hamt, size_t size);
+hamt_node_t *hamt_node_alloc(hamt_t *hamt, uint32_t bitmap, uint32_t leafmap);
+hamt_node_t *hamt_pair(hamt_t *hamt, hamt_leaf_t *a, hamt_leaf_t *b,
+                       unsigned shift);
+hamt_node_t *hamt_insert(hamt_t *hamt, const hamt_node_t *node,
+                         hamt_leaf_t *leaf, unsigned shift);
+
+static inline uint32_t hamt_bit(uint64_t hash, unsigned shift) {
+    return (uint32_t)1 << ((hash >> shift) & HAMT_MASK);
+}
+
+static inline unsigned hamt_pos(uint32_t bitmap, uint32_t bit) {
+    return __builtin_popcount(bitmap & (bit - 1));
+}
+
+int hamt_init(hamt_t *hamt) {
+    return hamt_init_with_allocator(hamt, &default_allocator);
+}
+
+int hamt_init_with_allocator(hamt_t *hamt, allocator_t *allocator) {
+    assert(hamt != NULL);
+    assert(allocator != NULL);
+
+    int res;
+
+    hamt->allocator = allocator;
+    hamt->id = __atomic_add_fetch(&hamt_next_id, 1, __ATOMIC_RELAXED);
+    hamt->root = NULL;
+    hamt->shared = NULL;
+
+    TRY(res, vector_init_with_allocator(&hamt->allocs, sizeof(void *),
+                                        allocator));
+    TRY(res, vector_init_with_allocator(&hamt->keys, sizeof(const symbol_t *),
+                                        allocator));
+
+    return 0;
+}
+
+void hamt_destroy(hamt_t *hamt) {
+    assert(hamt != NULL);
+
+    for (size_t i = 0; i < hamt->allocs.len; ++i) {
+        FREE(*(void **)vector_get_ref(&hamt->allocs, i));
+    }
+
+    vector_destroy(&hamt->allocs);
+    vector_destroy(&hamt->keys);
+}
+
+void hamt_share(hamt_t *hamt, const hamt_t *base) {
+    assert(hamt != NULL);
+    assert(base != NULL);
+    assert(hamt->keys.len == 0);
+
+    hamt->root = base->root;
+    hamt->shared = base->root;
+}
+
+const vector_t *hamt_keys(const hamt_t *hamt) {
+    assert(hamt != NULL);
+
+    return &hamt->keys;
+}
+
+hamt_mark_t hamt_mark(const hamt_t *hamt) {
+    assert(hamt != NULL);
+
+    hamt_mark_t mark = {hamt->root, hamt->shared, hamt->allocs.len,
+                        hamt->keys.len};
+
+    return mark;
+}
+
+// Undoes every put since mark was taken and frees the nodes they built. Maps
+// shared from this one since then must have been destroyed already.
+void hamt_rewind(hamt_t *hamt, hamt_mark_t mark) {
+    assert(hamt != NULL);
+    assert(mark.allocs <= hamt->allocs.len);
+
+    for (size_t i = mark.allocs; i < hamt->allocs.len; ++i) {
+        FREE(*(void **)vector_get_ref(&hamt->allocs, i));
+    }
+
+    hamt->root = mark.root;
+    hamt->shared = mark.shared;
+    hamt->allocs.len = mark.allocs;
+    hamt->keys.len = mark.keys;
+}
+
+void *hamt_track(hamt_t *hamt, size_t size) {
+    void *mem, *memres;
+
+    TRYCR(mem, ALLOC(size), NULL, NULL);
+    TRYCR(memres, vector_push_back(&hamt->allocs, &mem), NULL, NULL);
+
+    return mem;
+}
+
+hamt_node_t *hamt_node_alloc(hamt_t *hamt, uint32_t bitmap, uint32_t leafmap) {
+    hamt_node_t *node;
+
+    TRYCR(node,
+          hamt_track(hamt, sizeof(hamt_node_t) +
+                               __builtin_popcount(bitmap) * sizeof(void *)),
+          NULL, NULL);
+
+    node->bitmap = bitmap;
+    node->leafmap = leafmap;
+
+    return node;
+}
+
+// Builds the subtree holding two leaf chains whose hashes differ
+hamt_node_t *hamt_pair(hamt_t *hamt, hamt_leaf_t *a, hamt_leaf_t *b,
+                       unsigned shift) {
+    uint32_t bit_a = hamt_bit(a->key->hash, shift);
+    uint32_t bit_b = hamt_bit(b->key->hash, shift);
+    hamt_node_t *node;
+
+    if (bit_a == bit_b) {
+        TRYCR(node, hamt_node_alloc(hamt, bit_a, 0), NULL, NULL);
+        TRYCR(node->children[0], hamt_pair(hamt, a, b, shift + HAMT_BITS),
+              NULL, NULL);
+
+        return node;
+    }
+
+    TRYCR(node, hamt_node_alloc(hamt, bit_a | bit_b, bit_a | bit_b), NULL,
+          NULL);
+    node->children[bit_a < bit_b ? 0 : 1] = a;
+    node->children[bit_a < bit_b ? 1 : 0] = b;
+
+    return node;
+}
+
+// Returns a copy of node with leaf added, sharing all untouched children
+hamt_node_t *hamt_insert(hamt_t *hamt, const hamt_node_t *node,
+                         hamt_leaf_t *leaf, unsigned shift) {
+    uint64_t hash = leaf->key->hash;
+    uint32_t bit = hamt_bit(hash, shift);
+    hamt_node_t *copy;
+
+    if (node == NULL) {
+        TRYCR(copy, hamt_node_alloc(hamt, bit, bit), NULL, NULL);
+        copy->children[0] = leaf;
+
+        return copy;
+    }
+
+    unsigned pos = hamt_pos(node->bitmap, bit);
+    size_t len = __builtin_popcount(node->bitmap);
+
+    if (!(node->bitmap & bit)) {
+        TRYCR(copy,
+              hamt_node_alloc(hamt, node->bitmap | bit, node->leafmap | bit),
+              NULL, NULL);
+
+        memcpy(copy->children, node->children, pos * sizeof(void *));
+        copy->children[pos] = leaf;
+        memcpy(copy->children + pos + 1, node->children + pos,
+               (len - pos) * sizeof(void *));
+
+        return copy;
+    }
+
+    void *child;
+
+    if (node->leafmap & bit) {
+        hamt_leaf_t *chain = node->children[pos];
+
+        if (chain->key->hash == hash) {
+            // Shadows any older leaf with the same key further down the chain
+            leaf->next = chain;
+            child = leaf;
+        } else {
+            TRYCR(child, hamt_pair(hamt, chain, leaf, shift + HAMT_BITS), NULL,
+                  NULL);
+        }
+    } else {
+        TRYCR(child,
+              hamt_insert(hamt, node->children[pos], leaf, shift + HAMT_BITS),
+              NULL, NULL);
+    }
+
+    uint32_t leafmap = child == leaf ? node->leafmap : node->leafmap & ~bit;
+
+    TRYCR(copy, hamt_node_alloc(hamt, node->bitmap, leafmap), NULL, NULL);
+
+    memcpy(copy->children, node->children, len * sizeof(void *));
+    copy->children[pos] = child;
+
+    return copy;
+}
+
+static inline hamt_leaf_t *hamt_find(const hamt_t *hamt, const symbol_t *key) {
+    const hamt_node_t *node = hamt->root;
+    uint64_t hash = key->hash;
+
+    for (unsigned shift = 0; node != NULL; shift += HAMT_BITS) {
+        uint32_t bit = hamt_bit(hash, shift);
+
+        if (!(node->bitmap & bit)) {
+            return NULL;
+        }
+
+        void *child = node->children[hamt_pos(node->bitmap, bit)];
+
+        if (node->leafmap & bit) {
+            for (hamt_leaf_t *leaf = child; leaf != NULL; leaf = leaf->next) {
+                if (leaf->key == key) {
+                    return leaf;
+                }
+            }
+
+            return NULL;
+        }
+
+        node = child;
+    }
+
+    return NULL;
+}
+
+int hamt_put_sym(hamt_t *hamt, const symbol_t *key, void *value) {
+    assert(hamt != NULL);
+    assert(key != NULL);
+
+    hamt_leaf_t *old = hamt_find(hamt, key);
+    hamt_leaf_t *leaf;
+    hamt_node_t *root;
+
+    TRYCR(leaf, hamt_track(hamt, sizeof(hamt_leaf_t)), NULL, -1);
+    leaf->key = key;
+    leaf->value = value;
+    leaf->owner = hamt->id;
+    leaf->next = NULL;
+
+    TRYCR(root, hamt_insert(hamt, hamt->root, leaf, 0), NULL, -1);
+    hamt->root = root;
+
+    if (old == NULL || old->owner != hamt->id) {
+        void *memres;
+        TRYCR(memres, vector_push_back(&hamt->keys, &key), NULL, -1);
+    }
+
+    return 0;
+}
+
+void *hamt_get_sym(const hamt_t *hamt, const symbol_t *key) {
+    assert(hamt != NULL);
+    assert(key != NULL);
+
+    hamt_leaf_t *leaf = hamt_find(hamt, key);
+
+    return leaf != NULL ? leaf->value : NULL;
+}
+
+// Looks up n keys, setting out[i] as hamt_get_sym(keys[i]) would. A batch of
+// keys goes down the trie one level at a time, prefetching the next node of
+// every key before following any of them.
+void hamt_get_many(const hamt_t *hamt, const symbol_t *const *keys, size_t n,
+                   void **out) {
+    assert(hamt != NULL);
+    assert(keys != NULL || n == 0);
+    assert(out != NULL || n == 0);
+
+    const hamt_node_t *nodes[HAMT_BATCH];
+
+    for (size_t start = 0; start < n; start += HAMT_BATCH) {
+        size_t len = n - start > HAMT_BATCH ? HAMT_BATCH : n - start;
+        size_t active = hamt->root != NULL ? len : 0;
+
+        for (size_t k = 0; k < len; ++k) {
+            nodes[k] = hamt->root;
+            out[start + k] = NULL;
+        }
+
+        for (unsigned shift = 0; active > 0; shift += HAMT_BITS) {
+            for (size_t k = 0; k < len; ++k) {
+                const hamt_node_t *node = nodes[k];
+
+                if (node == NULL) {
+                    continue;
+                }
+
+                const symbol_t *key = keys[start + k];
+                uint32_t bit = hamt_bit(key->hash, shift);
+
+                nodes[k] = NULL;
+                active--;
+
+                if (!(node->bitmap & bit)) {
+                    continue;
+                }
+
+                void *child = node->children[hamt_pos(node->bitmap, bit)];
+
+                if (node->leafmap & bit) {
+                    for (hamt_leaf_t *leaf = child; leaf != NULL;
+                         leaf = leaf->next) {
+                        if (leaf->key == key) {
+                            out[start + k] = leaf->value;
+                            break;
+                        }
+                    }
+                } else {
+                    __builtin_prefetch(child);
+                    nodes[k] = child;
+                    active++;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef SCHC_DATA_HAMT_H_
+#define SCHC_DATA_HAMT_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+#include "symtab.h"
+#include "vector.h"
+
+// Children per node, one level consumes HAMT_BITS bits of the key hash
+#define HAMT_BITS 5
+#define HAMT_WIDTH (1 << HAMT_BITS)
+// Keys hamt_get_many walks down the trie side by side
+#define HAMT_BATCH 16
+
+struct hamt_node_;
+
+// Persistent hash array mapped trie from symbols to pointers.
+//
+// Nodes are never modified once built: a put copies the path from the root
+// to the changed leaf and shares everything else. hamt_share makes a map
+// start from another map's current contents in O(1), and later puts on
+// either one are not seen by the other.
+//
+// A map that is still at its shared root has not been put into since, which
+// lets a scope chain skip lookups in maps that cannot have changed.
+//
+// Every map frees only the nodes it allocated itself, so a map must be
+// destroyed before any map it shares from.
+typedef struct hamt_ {
+    allocator_t *allocator;
+    uint64_t id; // Tags the leaves this map inserted
+    struct hamt_node_ *root;
+    const struct hamt_node_ *shared; // Root this map was shared from
+    vector_t /* void * */ allocs;
+    vector_t /* const symbol_t * */ keys; // Keys put in this map, in order
+} hamt_t;
+
+// State of a map to rewind it to, see hamt_mark
+typedef struct hamt_mark_ {
+    struct hamt_node_ *root;
+    const struct hamt_node_ *shared;
+    size_t allocs;
+    size_t keys;
+} hamt_mark_t;
+
+int hamt_init(hamt_t *hamt);
+int hamt_init_with_allocator(hamt_t *hamt, allocator_t *allocator);
+void hamt_destroy(hamt_t *hamt);
+
+void hamt_share(hamt_t *hamt, const hamt_t *base);
+
+const vector_t *hamt_keys(const hamt_t *hamt);
+
+hamt_mark_t hamt_mark(const hamt_t *hamt);
+void hamt_rewind(hamt_t *hamt, hamt_mark_t mark);
+
+int hamt_put_sym(hamt_t *hamt, const symbol_t *key, void *value);
+void *hamt_get_sym(const hamt_t *hamt, const symbol_t *key);
+void hamt_get_many(const hamt_t *hamt, const symbol_t *const *keys, size_t n,
+                   void **out);
+
+#endif /*SCHC_DATA_HAMT_H_*/
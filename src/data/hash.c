@@ -0,0 +1,125 @@
+#include "hash.h"
+
+#include <assert.h>
+#include <string.h>
+
+// 64 bit string hash in the style of wyhash: input is read 8 (or 4) bytes at
+// a time and folded with 64x64->128 bit multiplications.
+
+#define HASH_SEED UINT64_C(0xa0761d6478bd642f)
+
+static const uint64_t hash_secret[4] = {
+    UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47)};
+
+static inline void hash_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32;
+    uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif /*__SIZEOF_INT128__*/
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+    hash_mum(&a, &b);
+
+    return a ^ b;
+}
+
+static inline uint64_t hash_read8(const uint8_t *p) {
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+static inline uint64_t hash_read4(const uint8_t *p) {
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+// Reads 1 to 3 bytes
+static inline uint64_t hash_read3(const uint8_t *p, size_t len) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+uint64_t hash_bytes(const void *data, size_t len) {
+    assert(data != NULL || len == 0);
+
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t seed = HASH_SEED ^ hash_mix(HASH_SEED ^ hash_secret[0],
+                                         hash_secret[1]);
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            // Two possibly overlapping 4 byte reads from each end
+            size_t mid = (len >> 3) << 2;
+
+            a = (hash_read4(p) << 32) | hash_read4(p + mid);
+            b = (hash_read4(p + len - 4) << 32) | hash_read4(p + len - 4 - mid);
+        } else if (len > 0) {
+            a = hash_read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+
+        if (i > 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+
+            do {
+                seed = hash_mix(hash_read8(p) ^ hash_secret[1],
+                                hash_read8(p + 8) ^ seed);
+                seed1 = hash_mix(hash_read8(p + 16) ^ hash_secret[2],
+                                 hash_read8(p + 24) ^ seed1);
+                seed2 = hash_mix(hash_read8(p + 32) ^ hash_secret[3],
+                                 hash_read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (i > 16) {
+            seed = hash_mix(hash_read8(p) ^ hash_secret[1],
+                            hash_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+
+        a = hash_read8(p + i - 16);
+        b = hash_read8(p + i - 8);
+    }
+
+    a ^= hash_secret[1];
+    b ^= seed;
+    hash_mum(&a, &b);
+
+    return hash_mix(a ^ hash_secret[0] ^ len, b ^ hash_secret[1]);
+}
+
+uint64_t hash_str(const char *str) {
+    assert(str != NULL);
+
+    return hash_bytes(str, strlen(str));
+}
@@ -0,0 +1,10 @@
+#ifndef SCHC_DATA_HASH_H_
+#define SCHC_DATA_HASH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+uint64_t hash_bytes(const void *data, size_t len);
+uint64_t hash_str(const char *str);
+
+#endif /*SCHC_DATA_HASH_H_*/
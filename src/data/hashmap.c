@@ -5,11 +5,20 @@
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__SSE2__) && !defined(HASHMAP_NO_SIMD)
+#include <emmintrin.h>
+#endif /*__SSE2__ && !HASHMAP_NO_SIMD*/
+
+#include <data/hash.h>
 #include <data/vector.h>
 #include <util.h>
 
-#define HASHMAP_DEFAULT_CAP 1024
-#define FIBONACCI_MULT UINT64_C(11400714819323198486)
+// Capacity of the first hash table after a small map overflows
+#define HASHMAP_MIN_CAP 32
+
+// Control byte of a free slot. Used slots store the 7 bit H2 of their key so
+// the high bit tells them apart.
+#define CTRL_EMPTY ((uint8_t)0x80)
 
 #define ALLOC(size) ALLOCATOR_ALLOC(hashmap->allocator, (size))
 #define STRALLOC(str) ALLOCATOR_STRALLOC(hashmap->allocator, (str))
@@ -17,13 +26,81 @@
 #define FREE(mem) ALLOCATOR_FREE(hashmap->allocator, (mem))
 
 int hashmap_grow(hashmap_t *hashmap);
-uint64_t hash(const char *str);
+void hashmap_migrate(hashmap_t *hashmap, size_t slots);
+int hashmap_take_old(hashmap_t *hashmap, const symbol_t *key, size_t i);
+void hashmap_old_view(const hashmap_t *hashmap, hashmap_t *view);
+void hashmap_remove_slot(hashmap_t *hashmap, size_t i);
+void hashmap_remove_key(hashmap_t *hashmap, const symbol_t *key);
+int hashmap_alloc_table(hashmap_t *hashmap, size_t cap);
+int hashmap_alloc_small(hashmap_t *hashmap);
+size_t hashmap_probe(const hashmap_t *hashmap, const symbol_t *sym,
+                     const char *key, size_t len, uint64_t h, int *found);
+size_t hashmap_probe_empty(const hashmap_t *hashmap, uint64_t h);
+size_t hashmap_slot_size(const hashmap_t *hashmap);
+void hashmap_set_ctrl(hashmap_t *hashmap, size_t i, uint8_t ctrl);
+
+// Slot probing
+//
+// Slots are linearly probed, but instead of looking at keys one by one a whole
+// group of HASHMAP_GROUP_WIDTH control bytes is compared against the H2 of the
+// searched key at once. Only slots whose H2 matches are looked at. Symbol
+// lookups then just compare pointers. String lookups compare full hash and
+// length before touching the key, which lives in the slot itself when it is
+// short.
+// The control array has HASHMAP_GROUP_WIDTH mirrored bytes at its end so a
+// group can be loaded from any slot without wrapping around.
+
+// H1 (the home slot) comes from the top bits of the hash and H2 from the
+// bottom ones so they stay independent for any capacity
+static inline size_t hashmap_h1(const hashmap_t *hashmap, uint64_t h) {
+    return h >> (64 - hashmap->cap_pow);
+}
+
+static inline uint8_t hashmap_h2(uint64_t h) { return h & 0x7f; }
+
+#if defined(__SSE2__) && !defined(HASHMAP_NO_SIMD)
+
+static inline uint32_t group_match(const uint8_t *ctrl, uint8_t h2) {
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+}
+
+static inline uint32_t group_match_empty(const uint8_t *ctrl) {
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return _mm_movemask_epi8(group);
+}
+
+#else
+
+static inline uint32_t group_match(const uint8_t *ctrl, uint8_t h2) {
+    uint32_t mask = 0;
+
+    for (int i = 0; i < HASHMAP_GROUP_WIDTH; ++i) {
+        mask |= (uint32_t)(ctrl[i] == h2) << i;
+    }
+
+    return mask;
+}
+
+static inline uint32_t group_match_empty(const uint8_t *ctrl) {
+    uint32_t mask = 0;
+
+    for (int i = 0; i < HASHMAP_GROUP_WIDTH; ++i) {
+        mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    }
+
+    return mask;
+}
+
+#endif /*__SSE2__ && !HASHMAP_NO_SIMD*/
 
 int hashmap_init(hashmap_t *hashmap, size_t elem_size) {
     assert(hashmap != NULL);
     assert(elem_size >= 0);
 
-    return hashmap_init_with_cap(hashmap, elem_size, HASHMAP_DEFAULT_CAP);
+    return hashmap_init_with_cap(hashmap, elem_size, 0);
 }
 
 int hashmap_init_with_cap(hashmap_t *hashmap, size_t elem_size,
@@ -38,31 +115,34 @@ int hashmap_init_with_cap_and_allocator(hashmap_t *hashmap, size_t elem_size,
 
     assert(hashmap != NULL);
     assert(elem_size >= 0);
-    assert(initial_capacity >= 256);
+    assert(initial_capacity >= 0);
     assert(allocator != NULL);
 
-    size_t cap = 256;
-    int cap_pow = 8;
-
-    while (cap < initial_capacity) {
-        cap *= 2;
-        cap_pow++;
-    }
+    int res;
 
     hashmap->allocator = allocator;
     hashmap->len = 0;
-    hashmap->cap = cap;
     hashmap->elem_size = elem_size;
-    hashmap->cap_pow = cap_pow;
-
-    TRYCR(hashmap->mem, ALLOC(cap * (sizeof(hashmap_location_t) + elem_size)),
-          NULL, -1);
+    hashmap->incremental = 0;
+    hashmap->old.ctrl = NULL;
+
+    if (initial_capacity <= HASHMAP_SMALL_CAP) {
+        TRY(res, hashmap_alloc_small(hashmap));
+    } else {
+        size_t cap = HASHMAP_GROUP_WIDTH;
+        int cap_pow = 4;
+
+        while (cap < initial_capacity) {
+            cap *= 2;
+            cap_pow++;
+        }
 
-    memset(hashmap->mem, 0, (sizeof(hashmap_location_t) + elem_size) * cap);
+        hashmap->cap_pow = cap_pow;
+        TRY(res, hashmap_alloc_table(hashmap, cap));
+    }
 
-    int res;
-    TRY(res, vector_init_with_cap_and_allocator(
-                 &hashmap->keys, sizeof(const char *), cap, allocator));
+    TRY(res, vector_init_with_allocator(&hashmap->keys,
+                                        sizeof(const symbol_t *), allocator));
 
     return 0;
 }
@@ -70,22 +150,32 @@ int hashmap_init_with_cap_and_allocator(hashmap_t *hashmap, size_t elem_size,
 void hashmap_destroy(hashmap_t *hashmap) {
     assert(hashmap != NULL);
 
-    size_t vlen = hashmap->cap;
-
-    for (size_t i = 0; i < vlen; ++i) {
-        hashmap_location_t *loc = hashmap_get_entry(hashmap, i, NULL);
+    // Keys belong to the symbol table
+    FREE(hashmap->mem);
 
-        if (loc != NULL && loc->key != NULL) {
-            FREE(loc->key);
-        }
+    if (hashmap->ctrl != NULL) {
+        FREE(hashmap->ctrl);
     }
 
-    FREE(hashmap->mem);
+    if (hashmap->old.ctrl != NULL) {
+        FREE(hashmap->old.mem);
+        FREE(hashmap->old.ctrl);
+    }
 
     vector_destroy(&hashmap->keys);
 }
 
-const vector_t /* const char * */ *hashmap_keys(const hashmap_t *hashmap) {
+void hashmap_set_incremental(hashmap_t *hashmap, int incremental) {
+    assert(hashmap != NULL);
+
+    hashmap->incremental = incremental;
+
+    if (!incremental && hashmap->old.ctrl != NULL) {
+        hashmap_migrate(hashmap, hashmap->old.cap);
+    }
+}
+
+const vector_t /* const symbol_t * */ *hashmap_keys(const hashmap_t *hashmap) {
     assert(hashmap != NULL);
 
     return &hashmap->keys;
@@ -96,49 +186,78 @@ int hashmap_put(hashmap_t *hashmap, const char *key, const void *elem) {
     assert(key != NULL);
     assert(elem != NULL);
 
-    char *owned_key;
+    const symbol_t *sym;
 
-    TRYCR(owned_key, STRALLOC(key), NULL, -1);
+    TRYCR(sym, symtab_intern(key), NULL, -1);
 
-    return hashmap_put_no_alloc(hashmap, owned_key, elem);
+    return hashmap_put_sym(hashmap, sym, elem);
 }
 
+// Takes ownership of key, which must come from the hashmap allocator
 int hashmap_put_no_alloc(hashmap_t *hashmap, char *key, const void *elem) {
     assert(hashmap != NULL);
     assert(key != NULL);
     assert(elem != NULL);
-    assert(hashmap->len < hashmap->cap);
 
     int res;
-    int key_exists = 0;
 
-    uint64_t h = hash(key);
-    uint64_t fh = (h * FIBONACCI_MULT) >> (64 - hashmap->cap_pow);
+    TRY(res, hashmap_put(hashmap, key, elem));
+    FREE(key);
+
+    return 0;
+}
+
+int hashmap_put_sym(hashmap_t *hashmap, const symbol_t *key, const void *elem) {
+    assert(hashmap != NULL);
+    assert(key != NULL);
+    assert(elem != NULL);
+    assert(hashmap->len <= hashmap->cap);
+
+    int res;
+    int key_exists;
+
+    if (hashmap->old.ctrl != NULL) {
+        hashmap_migrate(hashmap, HASHMAP_MIGRATE_SLOTS);
+    }
 
-    hashmap_location_t *loc = hashmap_get_entry(hashmap, fh, NULL);
+    size_t i = hashmap_probe(hashmap, key, key->str, key->len, key->hash,
+                             &key_exists);
 
-    while (loc->key) {
-        if (strcmp(loc->key, key) == 0) {
-            FREE(loc->key);
-            hashmap->len--;
-            key_exists = 1;
-            break;
-        }
+    // A key still in the previous table moves to the slot it would get here
+    if (!key_exists && hashmap->old.ctrl != NULL) {
+        key_exists = hashmap_take_old(hashmap, key, i);
+    }
 
-        // Capacity is always a power of 2 so this is modulo
-        fh = (fh + 1) & (hashmap->cap - 1);
-        loc = hashmap_get_entry(hashmap, fh, NULL);
+    // A full small map turns into a hash table before taking new keys
+    if (!key_exists && hashmap->len == hashmap->cap) {
+        TRY(res, hashmap_grow(hashmap));
+        i = hashmap_probe(hashmap, key, key->str, key->len, key->hash,
+                          &key_exists);
     }
 
-    if (!key_exists) {
+    hashmap_location_t *loc = hashmap_get_entry(hashmap, i, NULL);
+
+    if (key_exists) {
+        hashmap->len--;
+    } else {
         vector_push_back(&hashmap->keys, &key);
+        hashmap_set_ctrl(hashmap, i, hashmap_h2(key->hash));
+
+        loc->hash = key->hash;
+        loc->key = key;
+        loc->key_len = key->len;
+        if (key->len < HASHMAP_SHORT_KEY_SIZE) {
+            memcpy(loc->short_key, key->str, key->len + 1);
+        } else {
+            loc->short_key[0] = '\0';
+        }
     }
 
-    loc->key = key;
     memcpy(loc->data, elem, hashmap->elem_size);
     hashmap->len++;
 
-    if (hashmap->len * 2 >= hashmap->cap) {
+    // Keep the load factor under 7/8
+    if (hashmap->ctrl != NULL && hashmap->len * 8 >= hashmap->cap * 7) {
         TRY(res, hashmap_grow(hashmap));
     }
 
@@ -149,22 +268,155 @@ void *hashmap_get(hashmap_t *hashmap, const char *key) {
     assert(hashmap != NULL);
     assert(key != NULL);
 
-    uint64_t h = hash(key);
-    uint64_t fh = (h * FIBONACCI_MULT) >> (64 - hashmap->cap_pow);
+    int found;
+    size_t len = strlen(key);
+    uint64_t h = hash_bytes(key, len);
+    size_t i = hashmap_probe(hashmap, NULL, key, len, h, &found);
+
+    if (!found) {
+        if (hashmap->old.ctrl != NULL) {
+            hashmap_t old;
+            hashmap_old_view(hashmap, &old);
+
+            i = hashmap_probe(&old, NULL, key, len, h, &found);
+            if (found) {
+                return hashmap_get_entry(&old, i, NULL)->data;
+            }
+        }
+
+        return NULL;
+    }
+
+    return hashmap_get_entry(hashmap, i, NULL)->data;
+}
+
+void *hashmap_get_sym(hashmap_t *hashmap, const symbol_t *key) {
+    assert(hashmap != NULL);
+    assert(key != NULL);
+
+    int found;
+    size_t i = hashmap_probe(hashmap, key, key->str, key->len, key->hash,
+                             &found);
+
+    if (!found) {
+        if (hashmap->old.ctrl != NULL) {
+            hashmap_t old;
+            hashmap_old_view(hashmap, &old);
+
+            i = hashmap_probe(&old, key, key->str, key->len, key->hash,
+                              &found);
+            if (found) {
+                return hashmap_get_entry(&old, i, NULL)->data;
+            }
+        }
+
+        return NULL;
+    }
+
+    return hashmap_get_entry(hashmap, i, NULL)->data;
+}
+
+// Looks up n keys, setting out[i] as hashmap_get_sym(keys[i]) would. The
+// control group and first slot of a batch of keys are prefetched before any
+// of them is probed, so their cache misses overlap instead of adding up.
+void hashmap_get_many(hashmap_t *hashmap, const symbol_t *const *keys,
+                      size_t n, void **out) {
+    assert(hashmap != NULL);
+    assert(keys != NULL || n == 0);
+    assert(out != NULL || n == 0);
+
+    for (size_t start = 0; start < n; start += HASHMAP_BATCH) {
+        size_t end = n - start > HASHMAP_BATCH ? start + HASHMAP_BATCH : n;
+
+        if (hashmap->ctrl != NULL) {
+            for (size_t i = start; i < end; ++i) {
+                size_t pos = hashmap_h1(hashmap, keys[i]->hash);
+
+                __builtin_prefetch(hashmap->ctrl + pos);
+                __builtin_prefetch(hashmap_get_entry(hashmap, pos, NULL));
+            }
+        }
+
+        for (size_t i = start; i < end; ++i) {
+            out[i] = hashmap_get_sym(hashmap, keys[i]);
+        }
+    }
+}
+
+int hashmap_remove(hashmap_t *hashmap, const char *key, void *out_elem) {
+    assert(hashmap != NULL);
+    assert(key != NULL);
+
+    const symbol_t *sym;
+
+    TRYCR(sym, symtab_intern(key), NULL, -1);
+
+    return hashmap_remove_sym(hashmap, sym, out_elem);
+}
+
+// Removes key, copying its element to out_elem unless that is NULL. Fails if
+// the key is not in the map.
+int hashmap_remove_sym(hashmap_t *hashmap, const symbol_t *key,
+                       void *out_elem) {
+    assert(hashmap != NULL);
+    assert(key != NULL);
+
+    int found;
+    size_t i = hashmap_probe(hashmap, key, key->str, key->len, key->hash,
+                             &found);
+
+    if (found) {
+        hashmap_location_t *loc = hashmap_get_entry(hashmap, i, NULL);
+
+        if (out_elem != NULL) {
+            memcpy(out_elem, loc->data, hashmap->elem_size);
+        }
+
+        hashmap_remove_slot(hashmap, i);
+    } else if (hashmap->old.ctrl != NULL) {
+        hashmap_t old;
+        hashmap_old_view(hashmap, &old);
 
-    hashmap_location_t *loc = hashmap_get_entry(hashmap, fh, NULL);
+        i = hashmap_probe(&old, key, key->str, key->len, key->hash, &found);
+        if (!found) {
+            return -1;
+        }
+
+        hashmap_location_t *loc = hashmap_get_entry(&old, i, NULL);
 
-    size_t limit = hashmap->cap;
-    while (loc->key && limit--) {
-        if (strcmp(key, loc->key) == 0) {
-            return loc->data;
+        if (out_elem != NULL) {
+            memcpy(out_elem, loc->data, hashmap->elem_size);
         }
 
-        fh = (fh + 1) & (hashmap->cap - 1);
-        loc = hashmap_get_entry(hashmap, fh, NULL);
+        // Same as taken over by a put, the migration will skip it
+        loc->key = NULL;
+        loc->key_len = SIZE_MAX;
+    } else {
+        return -1;
     }
 
-    return NULL;
+    hashmap->len--;
+    hashmap_remove_key(hashmap, key);
+
+    return 0;
+}
+
+// Keeps the capacity, so a map can be refilled without allocating
+void hashmap_clear(hashmap_t *hashmap) {
+    assert(hashmap != NULL);
+
+    if (hashmap->ctrl != NULL) {
+        memset(hashmap->ctrl, CTRL_EMPTY, hashmap->cap + HASHMAP_GROUP_WIDTH);
+    }
+
+    if (hashmap->old.ctrl != NULL) {
+        FREE(hashmap->old.mem);
+        FREE(hashmap->old.ctrl);
+        hashmap->old.ctrl = NULL;
+    }
+
+    hashmap->len = 0;
+    hashmap->keys.len = 0;
 }
 
 const void *hashmap_get_const(const hashmap_t *hashmap, const char *key) {
@@ -179,37 +431,331 @@ int hashmap_grow(hashmap_t *hashmap) {
 
     int res;
 
+    // Puts migrate faster than they fill the table, this is only a backstop
+    if (hashmap->old.ctrl != NULL) {
+        hashmap_migrate(hashmap, hashmap->old.cap);
+    }
+
     void *old_mem = hashmap->mem;
+    uint8_t *old_ctrl = hashmap->ctrl;
     size_t old_cap = hashmap->cap;
 
-    size_t new_cap = hashmap->cap * 2;
-    void *new_mem;
-
-    TRYCR(new_mem,
-          ALLOC(new_cap * (sizeof(hashmap_location_t) + hashmap->elem_size)),
-          NULL, -1);
-    memset(new_mem, 0,
-           new_cap * (sizeof(hashmap_location_t) + hashmap->elem_size));
-    hashmap->mem = new_mem;
-    hashmap->cap_pow++;
-    hashmap->cap = new_cap;
-    hashmap->len = 0;
+    if (old_ctrl == NULL) {
+        hashmap->cap_pow = 5;
+        TRY(res, hashmap_alloc_table(hashmap, HASHMAP_MIN_CAP));
+    } else {
+        hashmap->cap_pow++;
+        TRY(res, hashmap_alloc_table(hashmap, old_cap * 2));
+
+        if (hashmap->incremental) {
+            hashmap->old.ctrl = old_ctrl;
+            hashmap->old.mem = old_mem;
+            hashmap->old.cap = old_cap;
+            hashmap->old.cap_pow = hashmap->cap_pow - 1;
+            hashmap->old.next = 0;
+
+            return 0;
+        }
+    }
 
     for (size_t i = 0; i < old_cap; ++i) {
+        // Small maps keep their entries packed at the front
+        if (old_ctrl == NULL ? i >= hashmap->len : old_ctrl[i] & CTRL_EMPTY) {
+            continue;
+        }
+
         const hashmap_location_t *old_loc =
             hashmap_get_entry(hashmap, i, old_mem);
 
-        if (old_loc->key) {
-            TRY(res,
-                hashmap_put_no_alloc(hashmap, old_loc->key, old_loc->data));
-        }
+        // Keys are unique and the hash is in the slot, so no need to
+        // rehash or compare anything
+        size_t j = hashmap_probe_empty(hashmap, old_loc->hash);
+
+        memcpy(hashmap_get_entry(hashmap, j, NULL), old_loc,
+               hashmap_slot_size(hashmap));
+        hashmap_set_ctrl(hashmap, j, hashmap_h2(old_loc->hash));
     }
 
     FREE(old_mem);
 
+    if (old_ctrl != NULL) {
+        FREE(old_ctrl);
+    }
+
+    return 0;
+}
+
+// Removal
+//
+// Slots are probed linearly from the home slot and every key sits in the
+// first free slot after its home, so the slots in between are all used.
+// Instead of leaving a tombstone, a removal shifts back the following keys
+// that would otherwise end up past a free slot, until one is already at its
+// home or a free slot is reached. Lookups stay as short as if the removed key
+// had never been there.
+
+void hashmap_remove_slot(hashmap_t *hashmap, size_t i) {
+    if (hashmap->ctrl == NULL) {
+        // Small maps stay packed, the last entry fills the hole
+        size_t last = hashmap->len - 1;
+
+        if (i != last) {
+            memcpy(hashmap_get_entry(hashmap, i, NULL),
+                   hashmap_get_entry(hashmap, last, NULL),
+                   hashmap_slot_size(hashmap));
+        }
+
+        return;
+    }
+
+    size_t mask = hashmap->cap - 1;
+
+    for (size_t j = (i + 1) & mask;; j = (j + 1) & mask) {
+        if (hashmap->ctrl[j] & CTRL_EMPTY) {
+            break;
+        }
+
+        hashmap_location_t *loc = hashmap_get_entry(hashmap, j, NULL);
+        size_t home = hashmap_h1(hashmap, loc->hash);
+
+        // Keys whose home is cyclically in (i, j] can stay where they are
+        if (((j - home) & mask) < ((j - i) & mask)) {
+            continue;
+        }
+
+        memcpy(hashmap_get_entry(hashmap, i, NULL), loc,
+               hashmap_slot_size(hashmap));
+        hashmap_set_ctrl(hashmap, i, hashmap->ctrl[j]);
+        i = j;
+    }
+
+    hashmap_set_ctrl(hashmap, i, CTRL_EMPTY);
+}
+
+// Keys are usually removed in the reverse order they were put, as scopes are
+// popped, so they are searched for from the end
+void hashmap_remove_key(hashmap_t *hashmap, const symbol_t *key) {
+    const symbol_t **keys = vector_get_mem(&hashmap->keys);
+
+    for (size_t i = hashmap->keys.len; i-- > 0;) {
+        if (keys[i] == key) {
+            memmove(&keys[i], &keys[i + 1],
+                    (hashmap->keys.len - i - 1) * sizeof(const symbol_t *));
+            hashmap->keys.len--;
+
+            return;
+        }
+    }
+}
+
+// Incremental grows
+//
+// The previous table is walked in slot order. Entries a put already took
+// over have their key cleared but keep their control byte, so probe chains
+// through them stay intact.
+
+void hashmap_migrate(hashmap_t *hashmap, size_t slots) {
+    size_t end = hashmap->old.cap - hashmap->old.next > slots
+                     ? hashmap->old.next + slots
+                     : hashmap->old.cap;
+
+    for (size_t i = hashmap->old.next; i < end; ++i) {
+        if (hashmap->old.ctrl[i] & CTRL_EMPTY) {
+            continue;
+        }
+
+        const hashmap_location_t *old_loc =
+            hashmap_get_entry(hashmap, i, hashmap->old.mem);
+
+        if (old_loc->key == NULL) {
+            continue;
+        }
+
+        size_t j = hashmap_probe_empty(hashmap, old_loc->hash);
+
+        memcpy(hashmap_get_entry(hashmap, j, NULL), old_loc,
+               hashmap_slot_size(hashmap));
+        hashmap_set_ctrl(hashmap, j, hashmap_h2(old_loc->hash));
+    }
+
+    hashmap->old.next = end;
+
+    if (end == hashmap->old.cap) {
+        FREE(hashmap->old.mem);
+        FREE(hashmap->old.ctrl);
+        hashmap->old.ctrl = NULL;
+    }
+}
+
+// Moves key from the previous table to slot i, if it is there
+int hashmap_take_old(hashmap_t *hashmap, const symbol_t *key, size_t i) {
+    hashmap_t old;
+    int found;
+
+    hashmap_old_view(hashmap, &old);
+
+    size_t j =
+        hashmap_probe(&old, key, key->str, key->len, key->hash, &found);
+    if (!found) {
+        return 0;
+    }
+
+    hashmap_location_t *old_loc = hashmap_get_entry(&old, j, NULL);
+
+    memcpy(hashmap_get_entry(hashmap, i, NULL), old_loc,
+           hashmap_slot_size(hashmap));
+    hashmap_set_ctrl(hashmap, i, hashmap_h2(key->hash));
+
+    // Matches no lookup, neither by symbol nor by string
+    old_loc->key = NULL;
+    old_loc->key_len = SIZE_MAX;
+
+    return 1;
+}
+
+// A hashmap_t over the previous table, for probing it
+void hashmap_old_view(const hashmap_t *hashmap, hashmap_t *view) {
+    *view = *hashmap;
+    view->ctrl = hashmap->old.ctrl;
+    view->mem = hashmap->old.mem;
+    view->cap = hashmap->old.cap;
+    view->cap_pow = hashmap->old.cap_pow;
+}
+
+int hashmap_alloc_table(hashmap_t *hashmap, size_t cap) {
+    assert(hashmap != NULL);
+    assert(cap >= HASHMAP_GROUP_WIDTH);
+
+    // Slots are only read once their control byte is set, so they are left
+    // uninitialized. Zeroing a large table would touch every page at once.
+    TRYCR(hashmap->mem, ALLOC(cap * hashmap_slot_size(hashmap)), NULL, -1);
+
+    TRYCR(hashmap->ctrl, ALLOC(cap + HASHMAP_GROUP_WIDTH), NULL, -1);
+    memset(hashmap->ctrl, CTRL_EMPTY, cap + HASHMAP_GROUP_WIDTH);
+
+    hashmap->cap = cap;
+
     return 0;
 }
 
+int hashmap_alloc_small(hashmap_t *hashmap) {
+    assert(hashmap != NULL);
+
+    size_t mem_size = HASHMAP_SMALL_CAP * hashmap_slot_size(hashmap);
+
+    TRYCR(hashmap->mem, ALLOC(mem_size), NULL, -1);
+    memset(hashmap->mem, 0, mem_size);
+
+    hashmap->ctrl = NULL;
+    hashmap->cap = HASHMAP_SMALL_CAP;
+    hashmap->cap_pow = 3;
+
+    return 0;
+}
+
+static inline int hashmap_key_eq(const hashmap_location_t *loc,
+                                 const symbol_t *sym, const char *key,
+                                 size_t len, uint64_t h) {
+    if (sym != NULL) {
+        return loc->key == sym;
+    }
+
+    if (loc->hash != h || loc->key_len != len) {
+        return 0;
+    }
+
+    const char *loc_key =
+        len < HASHMAP_SHORT_KEY_SIZE ? loc->short_key : loc->key->str;
+
+    return memcmp(loc_key, key, len) == 0;
+}
+
+// When sym is given it is the interned key and only pointers get compared
+size_t hashmap_probe(const hashmap_t *hashmap, const symbol_t *sym,
+                     const char *key, size_t len, uint64_t h, int *found) {
+    assert(hashmap != NULL);
+    assert(key != NULL);
+    assert(found != NULL);
+
+    if (hashmap->ctrl == NULL) {
+        // Small map, entries are packed so the next free slot is len
+        for (size_t i = 0; i < hashmap->len; ++i) {
+            const hashmap_location_t *loc =
+                hashmap_get_entry((hashmap_t *)hashmap, i, NULL);
+
+            if (hashmap_key_eq(loc, sym, key, len, h)) {
+                *found = 1;
+                return i;
+            }
+        }
+
+        *found = 0;
+        return hashmap->len;
+    }
+
+    uint8_t h2 = hashmap_h2(h);
+    size_t mask = hashmap->cap - 1;
+    size_t pos = hashmap_h1(hashmap, h);
+
+    // The load factor guarantees an empty slot so this always terminates
+    for (;;) {
+        const uint8_t *group = hashmap->ctrl + pos;
+
+        for (uint32_t m = group_match(group, h2); m != 0; m &= m - 1) {
+            size_t i = (pos + __builtin_ctz(m)) & mask;
+            const hashmap_location_t *loc =
+                hashmap_get_entry((hashmap_t *)hashmap, i, NULL);
+
+            if (hashmap_key_eq(loc, sym, key, len, h)) {
+                *found = 1;
+                return i;
+            }
+        }
+
+        uint32_t empty = group_match_empty(group);
+        if (empty != 0) {
+            *found = 0;
+            return (pos + __builtin_ctz(empty)) & mask;
+        }
+
+        // Capacity is always a power of 2 so this is modulo
+        pos = (pos + HASHMAP_GROUP_WIDTH) & mask;
+    }
+}
+
+size_t hashmap_probe_empty(const hashmap_t *hashmap, uint64_t h) {
+    assert(hashmap != NULL);
+
+    size_t mask = hashmap->cap - 1;
+    size_t pos = hashmap_h1(hashmap, h);
+
+    for (;;) {
+        uint32_t empty = group_match_empty(hashmap->ctrl + pos);
+
+        if (empty != 0) {
+            return (pos + __builtin_ctz(empty)) & mask;
+        }
+
+        pos = (pos + HASHMAP_GROUP_WIDTH) & mask;
+    }
+}
+
+void hashmap_set_ctrl(hashmap_t *hashmap, size_t i, uint8_t ctrl) {
+    assert(hashmap != NULL);
+    assert(i < hashmap->cap);
+
+    if (hashmap->ctrl == NULL) {
+        return;
+    }
+
+    hashmap->ctrl[i] = ctrl;
+
+    // Mirror the first group past the end
+    if (i < HASHMAP_GROUP_WIDTH) {
+        hashmap->ctrl[hashmap->cap + i] = ctrl;
+    }
+}
+
 hashmap_location_t *hashmap_get_entry(hashmap_t *hashmap, size_t i, void *mem) {
     assert(hashmap != NULL);
     assert(i >= 0);
@@ -220,26 +766,16 @@ hashmap_location_t *hashmap_get_entry(hashmap_t *hashmap, size_t i, void *mem) {
     }
 
     return (hashmap_location_t *)(((char *)mem) +
-                                  i * (sizeof(hashmap_location_t) +
-                                       hashmap->elem_size));
+                                  i * hashmap_slot_size(hashmap));
 }
 
-// Hash
-
-uint64_t hash(const char *str) {
-    uint64_t res = 0;
-    const char *ptr = str;
-    uint64_t buf = 0;
-
-    while (*ptr != '\0') {
-        strncpy((char *)&buf, ptr, sizeof(uint64_t));
-
-        for (int i = 0; i < sizeof(uint64_t) && *ptr != '\0'; ++i, ++ptr)
-            ;
+size_t hashmap_slot_size(const hashmap_t *hashmap) {
+    assert(hashmap != NULL);
 
-        res = (res << 23) || (res >> 41);
-        res ^= buf;
-    }
+    // Round up so every slot header stays aligned
+    size_t align = sizeof(uint64_t);
+    size_t size = sizeof(hashmap_location_t) + hashmap->elem_size;
 
-    return res;
+    return (size + align - 1) & ~(align - 1);
 }
+
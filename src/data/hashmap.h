@@ -1,23 +1,52 @@
 #ifndef SCHC_DATA_HASHMAP_H_
 #define SCHC_DATA_HASHMAP_H_
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "allocator.h"
+#include "symtab.h"
 #include "vector.h"
 
+// Control bytes are probed HASHMAP_GROUP_WIDTH at a time
+#define HASHMAP_GROUP_WIDTH 16
+// Maps start as a plain array of this many slots that is scanned linearly and
+// only become a hash table once they outgrow it
+#define HASHMAP_SMALL_CAP 8
+// Slots of the previous table an incremental grow migrates per put
+#define HASHMAP_MIGRATE_SLOTS 8
+// Keys hashmap_get_many prefetches ahead of resolving them
+#define HASHMAP_BATCH 16
+
 typedef struct hashmap_ {
     allocator_t *allocator;
     size_t cap;
     size_t len;
     size_t elem_size;
     int cap_pow;
+    uint8_t *ctrl; // cap + HASHMAP_GROUP_WIDTH control bytes, NULL when small
     void *mem;
-    vector_t /* const char* */ keys;
+    vector_t /* const symbol_t * */ keys;
+    int incremental;
+    // Table an incremental grow is migrating from, ctrl is NULL otherwise
+    struct {
+        uint8_t *ctrl;
+        void *mem;
+        size_t cap;
+        int cap_pow;
+        size_t next; // Next slot to migrate
+    } old;
 } hashmap_t;
 
+// Keys shorter than this are also copied into the slot itself
+#define HASHMAP_SHORT_KEY_SIZE 16
+
+// Keys are interned, so a key match is a pointer compare
 typedef struct hashmap_location_ {
-    char *key;
+    uint64_t hash;
+    const symbol_t *key;
+    size_t key_len;
+    char short_key[HASHMAP_SHORT_KEY_SIZE];
     unsigned char data[0];
 } hashmap_location_t;
 
@@ -29,10 +58,25 @@ int hashmap_init_with_cap_and_allocator(hashmap_t *hashmap, size_t elem_size,
                                         allocator_t *allocator);
 void hashmap_destroy(hashmap_t *hashmap);
 
-const vector_t /* const char * */ *hashmap_keys(const hashmap_t *hashmap);
+// In incremental mode a grow keeps the previous table and moves
+// HASHMAP_MIGRATE_SLOTS of its slots per put, instead of rehashing
+// everything at once. Lookups look at both tables until it is empty. Slots
+// of the previous table are not reachable with hashmap_get_entry, iterate
+// over hashmap_keys instead.
+void hashmap_set_incremental(hashmap_t *hashmap, int incremental);
+
+const vector_t /* const symbol_t * */ *hashmap_keys(const hashmap_t *hashmap);
 int hashmap_put(hashmap_t *hashmap, const char *key, const void *elem);
 int hashmap_put_no_alloc(hashmap_t *hashmap, char *key, const void *elem);
+int hashmap_put_sym(hashmap_t *hashmap, const symbol_t *key, const void *elem);
 void *hashmap_get(hashmap_t *hashmap, const char *key);
+void *hashmap_get_sym(hashmap_t *hashmap, const symbol_t *key);
+void hashmap_get_many(hashmap_t *hashmap, const symbol_t *const *keys,
+                      size_t n, void **out);
+int hashmap_remove(hashmap_t *hashmap, const char *key, void *out_elem);
+int hashmap_remove_sym(hashmap_t *hashmap, const symbol_t *key,
+                       void *out_elem);
+void hashmap_clear(hashmap_t *hashmap);
 const void *hashmap_get_const(const hashmap_t *hashmap, const char *key);
 hashmap_location_t *hashmap_get_entry(hashmap_t *hashmap, size_t i, void *mem);
 
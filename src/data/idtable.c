@@ -0,0 +1,291 @@
+#include "idtable.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <util.h>
+
+#define IDMAP_INITIAL_CAP 16
+// Keys are stored as id + 1 so a zeroed slot is free
+#define IDMAP_KEY_SIZE sizeof(uint64_t)
+
+int bitset_grow(bitset_t *bitset, size_t len);
+int idvec_grow(idvec_t *idvec, size_t cap);
+int idmap_grow(idmap_t *idmap);
+
+// Doubles size until it holds at least min
+static size_t idtable_cap(size_t size, size_t min) {
+    if (size == 0) {
+        size = 1;
+    }
+
+    while (size < min) {
+        size *= 2;
+    }
+
+    return size;
+}
+
+#define ALLOC(size) ALLOCATOR_ALLOC(bitset->allocator, (size))
+#define REALLOC(ptr, size) ALLOCATOR_REALLOC(bitset->allocator, (ptr), (size))
+#define FREE(mem) ALLOCATOR_FREE(bitset->allocator, (mem))
+
+int bitset_init(bitset_t *bitset, size_t ids) {
+    return bitset_init_with_allocator(bitset, ids, &default_allocator);
+}
+
+int bitset_init_with_allocator(bitset_t *bitset, size_t ids,
+                               allocator_t *allocator) {
+    assert(bitset != NULL);
+    assert(allocator != NULL);
+
+    bitset->allocator = allocator;
+    bitset->len = ids / 64 + 1;
+
+    TRYCR(bitset->words, ALLOC(bitset->len * sizeof(uint64_t)), NULL, -1);
+    bitset_clear(bitset);
+
+    return 0;
+}
+
+void bitset_destroy(bitset_t *bitset) {
+    assert(bitset != NULL);
+
+    FREE(bitset->words);
+}
+
+int bitset_grow(bitset_t *bitset, size_t len) {
+    size_t new_len = idtable_cap(bitset->len, len);
+    uint64_t *words;
+
+    TRYCR(words, REALLOC(bitset->words, new_len * sizeof(uint64_t)), NULL,
+          -1);
+    memset(words + bitset->len, 0, (new_len - bitset->len) * sizeof(uint64_t));
+
+    bitset->words = words;
+    bitset->len = new_len;
+
+    return 0;
+}
+
+int bitset_set(bitset_t *bitset, uint32_t id) {
+    assert(bitset != NULL);
+
+    int res;
+
+    if (id / 64 >= bitset->len) {
+        TRY(res, bitset_grow(bitset, id / 64 + 1));
+    }
+
+    bitset->words[id / 64] |= (uint64_t)1 << (id % 64);
+
+    return 0;
+}
+
+void bitset_unset(bitset_t *bitset, uint32_t id) {
+    assert(bitset != NULL);
+
+    if (id / 64 < bitset->len) {
+        bitset->words[id / 64] &= ~((uint64_t)1 << (id % 64));
+    }
+}
+
+void bitset_clear(bitset_t *bitset) {
+    assert(bitset != NULL);
+
+    memset(bitset->words, 0, bitset->len * sizeof(uint64_t));
+}
+
+#undef ALLOC
+#undef REALLOC
+#undef FREE
+
+#define ALLOC(size) ALLOCATOR_ALLOC(idvec->allocator, (size))
+#define REALLOC(ptr, size) ALLOCATOR_REALLOC(idvec->allocator, (ptr), (size))
+#define FREE(mem) ALLOCATOR_FREE(idvec->allocator, (mem))
+
+int idvec_init(idvec_t *idvec, size_t elem_size, size_t ids) {
+    return idvec_init_with_allocator(idvec, elem_size, ids,
+                                     &default_allocator);
+}
+
+int idvec_init_with_allocator(idvec_t *idvec, size_t elem_size, size_t ids,
+                              allocator_t *allocator) {
+    assert(idvec != NULL);
+    assert(elem_size > 0);
+    assert(allocator != NULL);
+
+    idvec->allocator = allocator;
+    idvec->elem_size = elem_size;
+    idvec->cap = ids > 0 ? ids : 1;
+
+    TRYCR(idvec->mem, ALLOC(idvec->cap * elem_size), NULL, -1);
+    memset(idvec->mem, 0, idvec->cap * elem_size);
+
+    return 0;
+}
+
+void idvec_destroy(idvec_t *idvec) {
+    assert(idvec != NULL);
+
+    FREE(idvec->mem);
+}
+
+int idvec_grow(idvec_t *idvec, size_t cap) {
+    size_t new_cap = idtable_cap(idvec->cap, cap);
+    unsigned char *mem;
+
+    TRYCR(mem, REALLOC(idvec->mem, new_cap * idvec->elem_size), NULL, -1);
+    memset(mem + idvec->cap * idvec->elem_size, 0,
+           (new_cap - idvec->cap) * idvec->elem_size);
+
+    idvec->mem = mem;
+    idvec->cap = new_cap;
+
+    return 0;
+}
+
+void *idvec_get_ref(idvec_t *idvec, uint32_t id) {
+    assert(idvec != NULL);
+
+    if (id >= idvec->cap) {
+        if (idvec_grow(idvec, (size_t)id + 1)) {
+            return NULL;
+        }
+    }
+
+    return idvec->mem + (size_t)id * idvec->elem_size;
+}
+
+// Ids past the end read as zeroed elements, which are NULL here
+const void *idvec_get_const(const idvec_t *idvec, uint32_t id) {
+    assert(idvec != NULL);
+
+    if (id >= idvec->cap) {
+        return NULL;
+    }
+
+    return idvec->mem + (size_t)id * idvec->elem_size;
+}
+
+#undef ALLOC
+#undef REALLOC
+#undef FREE
+
+#define ALLOC(size) ALLOCATOR_ALLOC(idmap->allocator, (size))
+#define FREE(mem) ALLOCATOR_FREE(idmap->allocator, (mem))
+
+static inline size_t idmap_slot_size(const idmap_t *idmap) {
+    return IDMAP_KEY_SIZE + idmap->elem_size;
+}
+
+static inline unsigned char *idmap_slot(const idmap_t *idmap, size_t i) {
+    return idmap->mem + i * idmap_slot_size(idmap);
+}
+
+// Ids are dense, a multiplicative hash spreads neighbours over the table
+static inline size_t idmap_home(const idmap_t *idmap, uint32_t id) {
+    return (size_t)(((uint64_t)id * 0x9e3779b97f4a7c15ULL) >> 32) &
+           (idmap->cap - 1);
+}
+
+// Slot holding id, or the free slot it would go in
+static size_t idmap_probe(const idmap_t *idmap, uint32_t id) {
+    uint64_t key = (uint64_t)id + 1;
+
+    for (size_t i = idmap_home(idmap, id);; i = (i + 1) & (idmap->cap - 1)) {
+        uint64_t slot_key;
+        memcpy(&slot_key, idmap_slot(idmap, i), IDMAP_KEY_SIZE);
+
+        if (slot_key == key || slot_key == 0) {
+            return i;
+        }
+    }
+}
+
+int idmap_init(idmap_t *idmap, size_t elem_size) {
+    return idmap_init_with_allocator(idmap, elem_size, &default_allocator);
+}
+
+int idmap_init_with_allocator(idmap_t *idmap, size_t elem_size,
+                              allocator_t *allocator) {
+    assert(idmap != NULL);
+    assert(elem_size > 0);
+    assert(allocator != NULL);
+
+    idmap->allocator = allocator;
+    idmap->cap = IDMAP_INITIAL_CAP;
+    idmap->len = 0;
+    idmap->elem_size = elem_size;
+
+    TRYCR(idmap->mem, ALLOC(idmap->cap * idmap_slot_size(idmap)), NULL, -1);
+    memset(idmap->mem, 0, idmap->cap * idmap_slot_size(idmap));
+
+    return 0;
+}
+
+void idmap_destroy(idmap_t *idmap) {
+    assert(idmap != NULL);
+
+    FREE(idmap->mem);
+}
+
+int idmap_grow(idmap_t *idmap) {
+    idmap_t grown = *idmap;
+
+    grown.cap *= 2;
+    TRYCR(grown.mem, ALLOC(grown.cap * idmap_slot_size(&grown)), NULL, -1);
+    memset(grown.mem, 0, grown.cap * idmap_slot_size(&grown));
+
+    for (size_t i = 0; i < idmap->cap; ++i) {
+        unsigned char *slot = idmap_slot(idmap, i);
+        uint64_t key;
+        memcpy(&key, slot, IDMAP_KEY_SIZE);
+
+        if (key != 0) {
+            memcpy(idmap_slot(&grown, idmap_probe(&grown, key - 1)), slot,
+                   idmap_slot_size(idmap));
+        }
+    }
+
+    FREE(idmap->mem);
+    *idmap = grown;
+
+    return 0;
+}
+
+int idmap_put(idmap_t *idmap, uint32_t id, const void *elem) {
+    assert(idmap != NULL);
+    assert(elem != NULL);
+
+    int res;
+
+    // Keep the load factor under 3/4
+    if ((idmap->len + 1) * 4 > idmap->cap * 3) {
+        TRY(res, idmap_grow(idmap));
+    }
+
+    unsigned char *slot = idmap_slot(idmap, idmap_probe(idmap, id));
+    uint64_t key;
+    memcpy(&key, slot, IDMAP_KEY_SIZE);
+
+    if (key == 0) {
+        key = (uint64_t)id + 1;
+        memcpy(slot, &key, IDMAP_KEY_SIZE);
+        idmap->len++;
+    }
+
+    memcpy(slot + IDMAP_KEY_SIZE, elem, idmap->elem_size);
+
+    return 0;
+}
+
+void *idmap_get(const idmap_t *idmap, uint32_t id) {
+    assert(idmap != NULL);
+
+    unsigned char *slot = idmap_slot(idmap, idmap_probe(idmap, id));
+    uint64_t key;
+    memcpy(&key, slot, IDMAP_KEY_SIZE);
+
+    return key != 0 ? slot + IDMAP_KEY_SIZE : NULL;
+}
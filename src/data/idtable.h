@@ -0,0 +1,67 @@
+#ifndef SCHC_DATA_IDTABLE_H_
+#define SCHC_DATA_IDTABLE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+
+// Side tables keyed by small dense ids, like those of core_expr_t. They let a
+// pass attach data to nodes without hashing pointers. All of them grow on
+// demand, so ids do not have to be known up front.
+
+// One bit per id
+typedef struct bitset_ {
+    allocator_t *allocator;
+    uint64_t *words;
+    size_t len; // In words
+} bitset_t;
+
+int bitset_init(bitset_t *bitset, size_t ids);
+int bitset_init_with_allocator(bitset_t *bitset, size_t ids,
+                               allocator_t *allocator);
+void bitset_destroy(bitset_t *bitset);
+
+int bitset_set(bitset_t *bitset, uint32_t id);
+void bitset_unset(bitset_t *bitset, uint32_t id);
+void bitset_clear(bitset_t *bitset);
+
+static inline int bitset_test(const bitset_t *bitset, uint32_t id) {
+    return id / 64 < bitset->len &&
+           (bitset->words[id / 64] >> (id % 64)) & 1;
+}
+
+// One zero initialized elem_size element per id, for data most nodes have
+typedef struct idvec_ {
+    allocator_t *allocator;
+    unsigned char *mem;
+    size_t cap;
+    size_t elem_size;
+} idvec_t;
+
+int idvec_init(idvec_t *idvec, size_t elem_size, size_t ids);
+int idvec_init_with_allocator(idvec_t *idvec, size_t elem_size, size_t ids,
+                              allocator_t *allocator);
+void idvec_destroy(idvec_t *idvec);
+
+void *idvec_get_ref(idvec_t *idvec, uint32_t id);
+const void *idvec_get_const(const idvec_t *idvec, uint32_t id);
+
+// Open addressing map from id to elem_size element, for data few nodes have
+typedef struct idmap_ {
+    allocator_t *allocator;
+    size_t cap;
+    size_t len;
+    size_t elem_size;
+    unsigned char *mem;
+} idmap_t;
+
+int idmap_init(idmap_t *idmap, size_t elem_size);
+int idmap_init_with_allocator(idmap_t *idmap, size_t elem_size,
+                              allocator_t *allocator);
+void idmap_destroy(idmap_t *idmap);
+
+int idmap_put(idmap_t *idmap, uint32_t id, const void *elem);
+void *idmap_get(const idmap_t *idmap, uint32_t id);
+
+#endif /*SCHC_DATA_IDTABLE_H_*/
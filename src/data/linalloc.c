@@ -7,7 +7,12 @@
 
 #define LINALLOC_FIRST_SIZE 32678
 
+static __thread linalloc_t *linalloc_current = NULL;
+
 int linalloc_new_block(linalloc_t *linalloc);
+void *linalloc_bump(linalloc_t *linalloc, size_t header, size_t size,
+                    size_t align);
+int linalloc_extend(linalloc_t *linalloc, void *ptr, size_t size);
 
 int linalloc_init(linalloc_t *linalloc) {
     assert(linalloc != NULL);
@@ -15,7 +20,14 @@ int linalloc_init(linalloc_t *linalloc) {
     int res;
 
     linalloc->next_block_size = LINALLOC_FIRST_SIZE;
+    linalloc->last = NULL;
+    linalloc->parent = NULL;
     TRY(res, stack_init(&linalloc->blocks, sizeof(linalloc_block_t)));
+    TRY(res, stack_init(&linalloc->adopted, sizeof(linalloc_block_t)));
+
+    if (pthread_mutex_init(&linalloc->adopted_lock, NULL) != 0) {
+        return -1;
+    }
 
     TRY(res, linalloc_new_block(linalloc));
 
@@ -32,7 +44,16 @@ void linalloc_destroy(linalloc_t *linalloc) {
         free(block->mem);
     }
 
+    for (size_t i = 0; i < linalloc->adopted.vector.len; ++i) {
+        linalloc_block_t *block =
+            (linalloc_block_t *)vector_get_ref(&linalloc->adopted.vector, i);
+
+        free(block->mem);
+    }
+
     stack_destroy(&linalloc->blocks);
+    stack_destroy(&linalloc->adopted);
+    pthread_mutex_destroy(&linalloc->adopted_lock);
 }
 
 void linalloc_allocator(linalloc_t *linalloc, allocator_t *allocator) {
@@ -42,48 +63,113 @@ void linalloc_allocator(linalloc_t *linalloc, allocator_t *allocator) {
     allocator->free = free_noop;
 }
 
-void *linalloc_alloc(linalloc_t *linalloc, size_t size) {
-    assert(linalloc != NULL);
-    assert(size > 0);
-
-    size += sizeof(size_t);
+int linalloc_fork(linalloc_t *parent, linalloc_t *child) {
+    assert(parent != NULL);
+    assert(child != NULL);
 
     int res;
 
-    linalloc_block_t *block;
+    TRY(res, linalloc_init(child));
+    child->parent = parent;
 
-    TRYCR(block, (linalloc_block_t *)stack_peek(&linalloc->blocks), NULL, NULL);
+    return 0;
+}
 
-    if (block->used + size > block->size) {
-        while (size > linalloc->next_block_size) {
-            linalloc->next_block_size *= 2;
+// Moves every block of child, adopted ones included, into parent and frees
+// the rest of child. Pointers into child stay valid. On failure both are left
+// as they were, child still owning its blocks.
+int linalloc_join(linalloc_t *parent, linalloc_t *child) {
+    assert(parent != NULL);
+    assert(child != NULL);
+    assert(child->parent == parent);
+
+    int res = 0;
+    stack_t *from[] = {&child->blocks, &child->adopted};
+
+    pthread_mutex_lock(&parent->adopted_lock);
+
+    size_t adopted_len = parent->adopted.vector.len;
+
+    for (size_t i = 0; i < 2 && res == 0; ++i) {
+        for (size_t j = 0; j < from[i]->vector.len; ++j) {
+            if (stack_push(&parent->adopted,
+                           (void *)vector_get_ref(&from[i]->vector, j))) {
+                res = -1;
+                break;
+            }
         }
+    }
 
-        TRYCR(res, linalloc_new_block(linalloc), -1, NULL);
-        TRYCR(block, (linalloc_block_t *)stack_peek(&linalloc->blocks), NULL,
-              NULL);
+    // Blocks copied before the failure are still child's to free
+    if (res != 0) {
+        parent->adopted.vector.len = adopted_len;
+    }
+
+    pthread_mutex_unlock(&parent->adopted_lock);
+
+    if (res != 0) {
+        return -1;
+    }
+
+    stack_destroy(&child->blocks);
+    stack_destroy(&child->adopted);
+    pthread_mutex_destroy(&child->adopted_lock);
+
+    return 0;
+}
+
+void linalloc_set_thread(linalloc_t *linalloc) { linalloc_current = linalloc; }
+
+linalloc_t *linalloc_thread() { return linalloc_current; }
+
+static void *linalloc_thread_alloc(void *alloc_data, size_t size) {
+    // A thread that never called linalloc_set_thread fails like a full
+    // allocator instead of crashing
+    if (linalloc_current == NULL) {
+        return NULL;
     }
 
-    void *ret = block->mem + block->used;
-    block->used += size;
+    return linalloc_alloc(linalloc_current, size);
+}
+
+static void *linalloc_thread_realloc(void *alloc_data, void *ptr,
+                                     size_t size) {
+    if (linalloc_current == NULL) {
+        return NULL;
+    }
+
+    return linalloc_realloc(linalloc_current, ptr, size);
+}
+
+void linalloc_thread_allocator(allocator_t *allocator) {
+    allocator->allocator_data = NULL;
+    allocator->alloc = linalloc_thread_alloc;
+    allocator->realloc = linalloc_thread_realloc;
+    allocator->free = free_noop;
+}
+
+void *linalloc_alloc(linalloc_t *linalloc, size_t size) {
+    assert(linalloc != NULL);
+    assert(size > 0);
+
+    void *ret;
+    TRYCR(ret, linalloc_bump(linalloc, sizeof(size_t), size, LINALLOC_ALIGN),
+          NULL, NULL);
 
     // Save alloc size
-    *((size_t *)ret) = size - sizeof(size_t);
+    *((size_t *)ret - 1) = size;
 
-    return ret + sizeof(size_t);
+    return ret;
 }
 
 void *linalloc_realloc(linalloc_t *linalloc, void *ptr, size_t size) {
     assert(linalloc != NULL);
     assert(size > 0);
 
-    size += sizeof(size_t);
-
     size_t old_size = *((size_t *)ptr - 1);
-    size_t new_size = size - sizeof(size_t);
 
-    if (new_size <= old_size) {
-        *((size_t *)ptr - 1) = new_size;
+    if (size <= old_size || linalloc_extend(linalloc, ptr, size)) {
+        *((size_t *)ptr - 1) = size;
 
         return ptr;
     }
@@ -91,11 +177,31 @@ void *linalloc_realloc(linalloc_t *linalloc, void *ptr, size_t size) {
     void *new;
     TRYCR(new, linalloc_alloc(linalloc, size), NULL, NULL);
 
-    // Save new size
-    *((size_t *)new) = new_size;
-    new += sizeof(size_t);
-
     // Copy old data
+    memcpy(new, ptr, old_size);
+
+    return new;
+}
+
+void *linalloc_alloc_raw(linalloc_t *linalloc, size_t size, size_t align) {
+    assert(linalloc != NULL);
+    assert(size > 0);
+    assert(align > 0 && (align & (align - 1)) == 0);
+
+    return linalloc_bump(linalloc, 0, size, align);
+}
+
+void *linalloc_realloc_raw(linalloc_t *linalloc, void *ptr, size_t old_size,
+                           size_t size, size_t align) {
+    assert(linalloc != NULL);
+    assert(size > 0);
+
+    if (size <= old_size || linalloc_extend(linalloc, ptr, size)) {
+        return ptr;
+    }
+
+    void *new;
+    TRYCR(new, linalloc_alloc_raw(linalloc, size, align), NULL, NULL);
 
     memcpy(new, ptr, old_size);
 
@@ -119,6 +225,47 @@ char *linalloc_stralloc(linalloc_t *linalloc, const char *src) {
     return dst;
 }
 
+// Allocations made before the mark can no longer grow in place, a rewind
+// would cut them short otherwise
+linalloc_mark_t linalloc_mark(linalloc_t *linalloc) {
+    assert(linalloc != NULL);
+    assert(linalloc->blocks.vector.len > 0);
+
+    linalloc_mark_t mark;
+
+    mark.block = linalloc->blocks.vector.len - 1;
+    mark.used = ((const linalloc_block_t *)vector_get_ref(
+                     &linalloc->blocks.vector, mark.block))
+                    ->used;
+    mark.next_block_size = linalloc->next_block_size;
+
+    linalloc->last = NULL;
+
+    return mark;
+}
+
+// Releases everything allocated since mark was taken. Blocks opened after it
+// are freed and the block it points into is cut back to where it was.
+void linalloc_rewind(linalloc_t *linalloc, linalloc_mark_t mark) {
+    assert(linalloc != NULL);
+    assert(mark.block < linalloc->blocks.vector.len);
+
+    linalloc_block_t block;
+
+    while (linalloc->blocks.vector.len > mark.block + 1) {
+        stack_pop(&linalloc->blocks, &block);
+        free(block.mem);
+    }
+
+    linalloc_block_t *top = (linalloc_block_t *)stack_peek(&linalloc->blocks);
+
+    assert(mark.used <= top->used);
+    top->used = mark.used;
+
+    linalloc->next_block_size = mark.next_block_size;
+    linalloc->last = NULL;
+}
+
 int linalloc_new_block(linalloc_t *linalloc) {
     assert(linalloc != NULL);
 
@@ -135,4 +282,58 @@ int linalloc_new_block(linalloc_t *linalloc) {
     TRY(res, stack_push(&linalloc->blocks, &next));
 
     return res;
-}
\ No newline at end of file
+}
+
+// Takes size bytes aligned to align from the current block, with header bytes
+// free in front of them, opening a new block if they do not fit
+void *linalloc_bump(linalloc_t *linalloc, size_t header, size_t size,
+                    size_t align) {
+    assert(linalloc != NULL);
+
+    int res;
+
+    linalloc_block_t *block;
+    TRYCR(block, (linalloc_block_t *)stack_peek(&linalloc->blocks), NULL, NULL);
+
+    uintptr_t base = (uintptr_t)block->mem;
+    uintptr_t start =
+        (base + block->used + header + align - 1) & ~(uintptr_t)(align - 1);
+
+    if (start + size > base + block->size) {
+        while (header + size + align > linalloc->next_block_size) {
+            linalloc->next_block_size *= 2;
+        }
+
+        TRYCR(res, linalloc_new_block(linalloc), -1, NULL);
+        TRYCR(block, (linalloc_block_t *)stack_peek(&linalloc->blocks), NULL,
+              NULL);
+
+        base = (uintptr_t)block->mem;
+        start = (base + header + align - 1) & ~(uintptr_t)(align - 1);
+    }
+
+    block->used = start + size - base;
+    linalloc->last = (void *)start;
+
+    return linalloc->last;
+}
+
+// Grows ptr to size bytes without moving it, which is only possible when it
+// is the last allocation and its block has room left
+int linalloc_extend(linalloc_t *linalloc, void *ptr, size_t size) {
+    assert(linalloc != NULL);
+
+    if (ptr == NULL || ptr != linalloc->last) {
+        return 0;
+    }
+
+    linalloc_block_t *block = (linalloc_block_t *)stack_peek(&linalloc->blocks);
+
+    if (ptr + size > block->mem + block->size) {
+        return 0;
+    }
+
+    block->used = ptr + size - block->mem;
+
+    return 1;
+}
@@ -1,6 +1,8 @@
 #ifndef SCHC_LINALLOC_H_
 #define SCHC_LINALLOC_H_
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "allocator.h"
@@ -12,18 +14,85 @@ typedef struct linalloc_block_ {
     void *mem;
 } linalloc_block_t;
 
+// Alignment of everything returned by linalloc_alloc. Nothing allocated in
+// an arena needs more than pointer alignment, and with it the size header
+// never leaves padding behind.
+#define LINALLOC_ALIGN sizeof(void *)
+
 typedef struct linalloc_ {
     size_t next_block_size;
     stack_t /*linalloc_block_t*/ blocks;
+    void *last; // Most recent allocation, the only one that can grow in place
+    struct linalloc_ *parent; // Set on linallocs made by linalloc_fork
+    // Blocks of joined children. They are only freed with this linalloc and
+    // never allocated from, so joins can run next to allocations.
+    pthread_mutex_t adopted_lock;
+    stack_t /*linalloc_block_t*/ adopted;
 } linalloc_t;
 
+// Position in a linalloc, everything allocated after it can be released with
+// linalloc_rewind
+typedef struct linalloc_mark_ {
+    size_t block;
+    size_t used;
+    size_t next_block_size;
+} linalloc_mark_t;
+
 int linalloc_init(linalloc_t *linalloc);
 void linalloc_destroy(linalloc_t *linalloc);
 
 void linalloc_allocator(linalloc_t *linalloc, allocator_t *allocator);
 
+// Threads
+//
+// A linalloc is used by a single thread at a time. To allocate on several
+// threads each one forks its own child from a shared parent, and the child
+// is joined back when the thread is done. Joining hands the child's blocks to
+// the parent, so whatever was allocated in the child lives until the parent
+// is destroyed. Joins of different children may run concurrently.
+int linalloc_fork(linalloc_t *parent, linalloc_t *child);
+int linalloc_join(linalloc_t *parent, linalloc_t *child);
+
+// Linalloc of the calling thread, set with linalloc_set_thread. The
+// linalloc_thread_allocator allocates from it, so one allocator_t can be
+// shared by code running on every thread.
+void linalloc_set_thread(linalloc_t *linalloc);
+linalloc_t *linalloc_thread();
+void linalloc_thread_allocator(allocator_t *allocator);
+
 void *linalloc_alloc(linalloc_t *linalloc, size_t size);
 void *linalloc_realloc(linalloc_t *linalloc, void *ptr, size_t size);
 char *linalloc_stralloc(linalloc_t *linalloc, const char *src);
 
+// Header-free allocations for callers that keep track of sizes themselves.
+// They do not store their size in front, so they cannot be passed to
+// linalloc_realloc or used through linalloc_allocator.
+void *linalloc_alloc_raw(linalloc_t *linalloc, size_t size, size_t align);
+void *linalloc_realloc_raw(linalloc_t *linalloc, void *ptr, size_t old_size,
+                           size_t size, size_t align);
+
+linalloc_mark_t linalloc_mark(linalloc_t *linalloc);
+void linalloc_rewind(linalloc_t *linalloc, linalloc_mark_t mark);
+
+// Bump pointer path of linalloc_alloc_raw that can be inlined into callers,
+// only going out of line when the current block is full
+static inline void *linalloc_alloc_inline(linalloc_t *linalloc, size_t size,
+                                          size_t align) {
+    linalloc_block_t *block = (linalloc_block_t *)linalloc->blocks.vector.mem +
+                              linalloc->blocks.vector.len - 1;
+
+    uintptr_t base = (uintptr_t)block->mem;
+    uintptr_t start =
+        (base + block->used + align - 1) & ~(uintptr_t)(align - 1);
+
+    if (start + size > base + block->size) {
+        return linalloc_alloc_raw(linalloc, size, align);
+    }
+
+    block->used = start + size - base;
+    linalloc->last = (void *)start;
+
+    return (void *)start;
+}
+
 #endif /*SCHC_LINALLOC_H_*/
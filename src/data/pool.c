@@ -0,0 +1,251 @@
+#define _DEFAULT_SOURCE
+
+#include "pool.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <util.h>
+
+// Failed steal rounds before a worker goes to sleep
+#define POOL_SPIN_ROUNDS 64
+
+// Worker the calling thread is, NULL outside of pools
+static __thread pool_worker_t *pool_current;
+
+void *pool_worker_main(void *data);
+pool_task_t *pool_take(pool_worker_t *worker);
+void pool_run(pool_task_t *task);
+
+size_t pool_cpu_count() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+int pool_init(pool_t *pool, size_t len) {
+    assert(pool != NULL);
+    assert(pool_current == NULL);
+
+    int res;
+
+    if (len == 0) {
+        len = pool_cpu_count();
+    }
+
+    pool->len = len;
+    pool->stop = 0;
+    pool->pending = 0;
+    pool->sleeping = 0;
+
+    TRYCR(pool->workers, malloc(len * sizeof(pool_worker_t)), NULL, -1);
+    TRYCR(pool->threads, malloc(len * sizeof(pthread_t)), NULL, -1);
+    TRY(res, pthread_mutex_init(&pool->lock, NULL));
+    TRY(res, pthread_cond_init(&pool->wake, NULL));
+
+    for (size_t i = 0; i < len; ++i) {
+        pool_worker_t *worker = &pool->workers[i];
+
+        worker->pool = pool;
+        worker->index = i;
+        worker->seed = i * 2654435761u + 1;
+        TRY(res, wsdeque_init(&worker->deque));
+    }
+
+    pool_current = &pool->workers[0];
+
+    for (size_t i = 1; i < len; ++i) {
+        TRY(res, pthread_create(&pool->threads[i], NULL, pool_worker_main,
+                                &pool->workers[i]));
+    }
+
+    return 0;
+}
+
+void pool_destroy(pool_t *pool) {
+    assert(pool != NULL);
+    assert(pool_current == &pool->workers[0]);
+
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->stop, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 1; i < pool->len; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < pool->len; ++i) {
+        wsdeque_destroy(&pool->workers[i].deque);
+    }
+
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->workers);
+
+    pool_current = NULL;
+}
+
+void pool_run(pool_task_t *task) {
+    task->fn(task->arg);
+    __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+// Own work first, then a steal from each other worker starting at a random
+// one
+pool_task_t *pool_take(pool_worker_t *worker) {
+    pool_t *pool = worker->pool;
+    pool_task_t *task = wsdeque_pop(&worker->deque);
+
+    if (task == NULL && pool->len > 1) {
+        worker->seed = worker->seed * 1103515245 + 12345;
+        size_t victim = (worker->seed >> 16) % pool->len;
+
+        for (size_t i = 0; i < pool->len && task == NULL; ++i) {
+            if (victim != worker->index) {
+                task = wsdeque_steal(&pool->workers[victim].deque);
+            }
+            victim = victim + 1 < pool->len ? victim + 1 : 0;
+        }
+    }
+
+    if (task != NULL) {
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+    }
+
+    return task;
+}
+
+void *pool_worker_main(void *data) {
+    pool_worker_t *worker = data;
+    pool_t *pool = worker->pool;
+    int idle = 0;
+
+    pool_current = worker;
+
+    while (!__atomic_load_n(&pool->stop, __ATOMIC_SEQ_CST)) {
+        pool_task_t *task = pool_take(worker);
+
+        if (task != NULL) {
+            pool_run(task);
+            idle = 0;
+        } else if (++idle < POOL_SPIN_ROUNDS) {
+            sched_yield();
+        } else {
+            // pending and sleeping are both seq_cst, so either a pusher sees
+            // this worker sleeping or the worker sees its task pending
+            pthread_mutex_lock(&pool->lock);
+            __atomic_add_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+
+            while (!__atomic_load_n(&pool->stop, __ATOMIC_SEQ_CST) &&
+                   __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0) {
+                pthread_cond_wait(&pool->wake, &pool->lock);
+            }
+
+            __atomic_sub_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&pool->lock);
+            idle = 0;
+        }
+    }
+
+    return NULL;
+}
+
+int pool_fork(pool_t *pool, pool_task_t *task, pool_fn_t fn, void *arg) {
+    assert(pool != NULL);
+    assert(task != NULL);
+    assert(fn != NULL);
+    assert(pool_current != NULL && pool_current->pool == pool);
+
+    int res;
+
+    task->fn = fn;
+    task->arg = arg;
+    task->done = 0;
+
+    TRY(res, wsdeque_push(&pool_current->deque, task));
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&pool->sleeping, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return 0;
+}
+
+void pool_join(pool_t *pool, pool_task_t *task) {
+    assert(pool != NULL);
+    assert(task != NULL);
+    assert(pool_current != NULL && pool_current->pool == pool);
+
+    while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+        pool_task_t *other = pool_take(pool_current);
+
+        if (other != NULL) {
+            pool_run(other);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+// Parallel for
+
+typedef struct pool_range_ {
+    pool_t *pool;
+    vector_t *vector;
+    size_t grain;
+    size_t start;
+    size_t end;
+    pool_for_fn_t fn;
+    void *arg;
+} pool_range_t;
+
+// Halves the range, forking the upper half, until it is grain sized
+static void pool_range_run(void *data) {
+    pool_range_t *range = data;
+
+    while (range->end - range->start > range->grain) {
+        pool_range_t upper = *range;
+        pool_task_t task;
+
+        upper.start = range->start + (range->end - range->start) / 2;
+
+        if (pool_fork(range->pool, &task, pool_range_run, &upper)) {
+            break; // Out of memory, do the rest here
+        }
+
+        range->end = upper.start;
+        pool_range_run(range);
+        pool_join(range->pool, &task);
+
+        return;
+    }
+
+    for (size_t i = range->start; i < range->end; ++i) {
+        range->fn((void *)vector_get_ref(range->vector, i), i, range->arg);
+    }
+}
+
+void pool_parallel_for(pool_t *pool, vector_t *vector, size_t grain,
+                       pool_for_fn_t fn, void *arg) {
+    assert(pool != NULL);
+    assert(vector != NULL);
+    assert(fn != NULL);
+
+    pool_range_t range = {
+        .pool = pool,
+        .vector = vector,
+        .grain = grain > 0 ? grain : 1,
+        .start = 0,
+        .end = vector->len,
+        .fn = fn,
+        .arg = arg,
+    };
+
+    pool_range_run(&range);
+}
@@ -0,0 +1,66 @@
+#ifndef SCHC_DATA_POOL_H_
+#define SCHC_DATA_POOL_H_
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "vector.h"
+#include "wsdeque.h"
+
+// Ranges of a parallel for are split down to this many elements by default
+#define POOL_DEFAULT_GRAIN 16
+
+typedef void (*pool_fn_t)(void *arg);
+typedef void (*pool_for_fn_t)(void *elem, size_t index, void *arg);
+
+// A forked call. Lives with the caller, usually on its stack, until joined.
+typedef struct pool_task_ {
+    pool_fn_t fn;
+    void *arg;
+    int done;
+} pool_task_t;
+
+typedef struct pool_worker_ {
+    struct pool_ *pool;
+    size_t index;
+    unsigned seed; // Picks steal victims
+    wsdeque_t deque;
+} pool_worker_t;
+
+// Work-stealing thread pool
+//
+// Every worker owns a deque. Forked tasks go to the bottom of the forking
+// worker's deque and it takes them back from there, so it mostly runs its
+// own work depth first. Idle workers steal from the top of random other
+// deques, which holds the oldest and usually largest tasks.
+//
+// The thread calling pool_init is worker 0 and only runs tasks while it
+// joins, the other len - 1 workers get their own threads. Only workers may
+// fork and join. Joining never blocks, the joining worker runs other tasks
+// until the one it waits for is done.
+typedef struct pool_ {
+    size_t len;
+    pool_worker_t *workers;
+    pthread_t *threads;
+    int stop;
+    size_t pending;  // Tasks pushed but not taken
+    size_t sleeping; // Workers waiting on wake
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+} pool_t;
+
+size_t pool_cpu_count();
+
+// len == 0 sizes the pool from the CPU count
+int pool_init(pool_t *pool, size_t len);
+void pool_destroy(pool_t *pool);
+
+int pool_fork(pool_t *pool, pool_task_t *task, pool_fn_t fn, void *arg);
+void pool_join(pool_t *pool, pool_task_t *task);
+
+// Calls fn on every element of vector, splitting it in ranges of about grain
+// elements that run in parallel. Returns once all are done.
+void pool_parallel_for(pool_t *pool, vector_t *vector, size_t grain,
+                       pool_for_fn_t fn, void *arg);
+
+#endif /*SCHC_DATA_POOL_H_*/
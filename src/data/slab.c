@@ -0,0 +1,193 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "slab.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util.h"
+
+// Objects start this far into their slab, keeping them 16 byte aligned
+#define SLAB_HEADER_SIZE ((sizeof(slab_t) + 15) & ~(size_t)15)
+
+static const size_t slab_class_sizes[SLAB_CLASSES] = {
+    16,  32,  48,  64,  80,  96,  112, 128, 144,  160,  176,
+    192, 208, 224, 240, 256, 384, 512, 768, 1024, 1536, 2048,
+};
+
+slab_t *slab_new(slab_pool_t *pool, size_t elem_size, size_t slab_size);
+
+static inline int slab_class(size_t size) {
+    if (size <= 256) {
+        return (size - 1) >> 4;
+    }
+
+    int class = 16;
+    while (slab_class_sizes[class] < size) {
+        class++;
+    }
+
+    return class;
+}
+
+static inline slab_t *slab_of(void *ptr) {
+    return (slab_t *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+int slab_pool_init(slab_pool_t *pool) {
+    assert(pool != NULL);
+
+    for (int i = 0; i < SLAB_CLASSES; ++i) {
+        pool->free_lists[i] = NULL;
+        pool->cursors[i] = NULL;
+        pool->limits[i] = NULL;
+    }
+
+    pool->slabs = NULL;
+
+    return 0;
+}
+
+void slab_pool_destroy(slab_pool_t *pool) {
+    assert(pool != NULL);
+
+    slab_t *slab = pool->slabs;
+
+    while (slab != NULL) {
+        slab_t *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    pool->slabs = NULL;
+}
+
+void slab_pool_allocator(slab_pool_t *pool, allocator_t *allocator) {
+    allocator->allocator_data = pool;
+    allocator->alloc = (void *)slab_pool_alloc;
+    allocator->realloc = (void *)slab_pool_realloc;
+    allocator->free = (void *)slab_pool_free;
+}
+
+void *slab_pool_alloc(slab_pool_t *pool, size_t size) {
+    assert(pool != NULL);
+    assert(size > 0);
+
+    if (size > SLAB_MAX_SMALL) {
+        slab_t *slab;
+        TRYCR(slab, slab_new(pool, size, SLAB_HEADER_SIZE + size), NULL,
+              NULL);
+
+        return (unsigned char *)slab + SLAB_HEADER_SIZE;
+    }
+
+    int class = slab_class(size);
+    size_t elem_size = slab_class_sizes[class];
+
+    void *ret = pool->free_lists[class];
+
+    if (ret != NULL) {
+        pool->free_lists[class] = *(void **)ret;
+
+        return ret;
+    }
+
+    if (pool->cursors[class] == NULL ||
+        pool->cursors[class] + elem_size > pool->limits[class]) {
+        slab_t *slab;
+        TRYCR(slab, slab_new(pool, elem_size, SLAB_SIZE), NULL, NULL);
+
+        pool->cursors[class] = (unsigned char *)slab + SLAB_HEADER_SIZE;
+        pool->limits[class] = (unsigned char *)slab + SLAB_SIZE;
+    }
+
+    ret = pool->cursors[class];
+    pool->cursors[class] += elem_size;
+
+    return ret;
+}
+
+void *slab_pool_realloc(slab_pool_t *pool, void *ptr, size_t size) {
+    assert(pool != NULL);
+    assert(size > 0);
+
+    if (ptr == NULL) {
+        return slab_pool_alloc(pool, size);
+    }
+
+    slab_t *slab = slab_of(ptr);
+    size_t old_size = slab->elem_size;
+
+    if (size <= old_size) {
+        return ptr;
+    }
+
+    void *new;
+    TRYCR(new, slab_pool_alloc(pool, size), NULL, NULL);
+
+    memcpy(new, ptr, old_size);
+    slab_pool_free(pool, ptr);
+
+    return new;
+}
+
+void slab_pool_free(slab_pool_t *pool, void *mem) {
+    assert(pool != NULL);
+
+    if (mem == NULL) {
+        return;
+    }
+
+    slab_t *slab = slab_of(mem);
+
+    assert(slab->pool == pool);
+
+    if (slab->elem_size > SLAB_MAX_SMALL) {
+        if (slab->prev != NULL) {
+            slab->prev->next = slab->next;
+        } else {
+            pool->slabs = slab->next;
+        }
+
+        if (slab->next != NULL) {
+            slab->next->prev = slab->prev;
+        }
+
+        free(slab);
+
+        return;
+    }
+
+    int class = slab_class(slab->elem_size);
+
+    *(void **)mem = pool->free_lists[class];
+    pool->free_lists[class] = mem;
+}
+
+// Allocates a SLAB_SIZE aligned slab of slab_size bytes and links it into
+// the pool
+slab_t *slab_new(slab_pool_t *pool, size_t elem_size, size_t slab_size) {
+    assert(pool != NULL);
+
+    void *mem;
+
+    if (posix_memalign(&mem, SLAB_SIZE, slab_size) != 0) {
+        return NULL;
+    }
+
+    slab_t *slab = (slab_t *)mem;
+
+    slab->pool = pool;
+    slab->elem_size = elem_size;
+    slab->prev = NULL;
+    slab->next = pool->slabs;
+
+    if (pool->slabs != NULL) {
+        pool->slabs->prev = slab;
+    }
+
+    pool->slabs = slab;
+
+    return slab;
+}
@@ -0,0 +1,45 @@
+#ifndef SCHC_DATA_SLAB_H_
+#define SCHC_DATA_SLAB_H_
+
+#include <stdlib.h>
+
+#include "allocator.h"
+
+// Slabs are SLAB_SIZE bytes and aligned to it, so the slab of any pointer
+// handed out is found by masking its low bits
+#define SLAB_SIZE ((size_t)64 << 10)
+
+// Size classes are 16 bytes apart up to 256, then grow by halves up to
+// SLAB_MAX_SMALL. Anything bigger gets a slab of its own.
+#define SLAB_CLASSES 22
+#define SLAB_MAX_SMALL 2048
+
+typedef struct slab_pool_ slab_pool_t;
+
+typedef struct slab_ {
+    slab_pool_t *pool;
+    size_t elem_size; // Size class, or the whole size of a large allocation
+    struct slab_ *prev;
+    struct slab_ *next;
+} slab_t;
+
+// Pool of fixed-size objects. Every size class bump allocates from its own
+// slabs, so objects of the same size end up packed together, and freed
+// objects go to a per-class free list to be handed out again first.
+struct slab_pool_ {
+    void *free_lists[SLAB_CLASSES];
+    unsigned char *cursors[SLAB_CLASSES];
+    unsigned char *limits[SLAB_CLASSES];
+    slab_t *slabs;
+};
+
+int slab_pool_init(slab_pool_t *pool);
+void slab_pool_destroy(slab_pool_t *pool);
+
+void slab_pool_allocator(slab_pool_t *pool, allocator_t *allocator);
+
+void *slab_pool_alloc(slab_pool_t *pool, size_t size);
+void *slab_pool_realloc(slab_pool_t *pool, void *ptr, size_t size);
+void slab_pool_free(slab_pool_t *pool, void *mem);
+
+#endif /*SCHC_DATA_SLAB_H_*/
@@ -0,0 +1,122 @@
+#include "smallvec.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SMALLVEC_MIN_HEAP_CAP 4
+
+#define ALLOC(size) ALLOCATOR_ALLOC(smallvec->allocator, (size))
+#define REALLOC(ptr, size) ALLOCATOR_REALLOC(smallvec->allocator, (ptr), (size))
+#define FREE(mem) ALLOCATOR_FREE(smallvec->allocator, (mem))
+
+static inline int smallvec_is_inline(const smallvec_t *smallvec) {
+    return smallvec->cap * smallvec->elem_size <= SMALLVEC_INLINE_SIZE;
+}
+
+int smallvec_init(smallvec_t *smallvec, size_t elem_size) {
+    return smallvec_init_with_allocator(smallvec, elem_size,
+                                        &default_allocator);
+}
+
+int smallvec_init_with_allocator(smallvec_t *smallvec, size_t elem_size,
+                                 allocator_t *allocator) {
+    assert(smallvec != NULL);
+    assert(elem_size > 0);
+    assert(allocator != NULL);
+
+    smallvec->allocator = allocator;
+    smallvec->elem_size = elem_size;
+    smallvec->len = 0;
+    smallvec->cap = SMALLVEC_INLINE_SIZE / elem_size;
+
+    return 0;
+}
+
+void smallvec_destroy(smallvec_t *smallvec) {
+    assert(smallvec != NULL);
+
+    if (!smallvec_is_inline(smallvec)) {
+        FREE(smallvec->heap_mem);
+    }
+}
+
+void *smallvec_get_mem(smallvec_t *smallvec) {
+    assert(smallvec != NULL);
+
+    return smallvec_is_inline(smallvec) ? smallvec->inline_mem
+                                        : smallvec->heap_mem;
+}
+
+const void *smallvec_get_ref(const smallvec_t *smallvec, size_t index) {
+    assert(smallvec != NULL);
+
+    if (index >= smallvec->len) {
+        return NULL;
+    }
+
+    const void *mem = smallvec_is_inline(smallvec) ? smallvec->inline_mem
+                                                   : smallvec->heap_mem;
+
+    return mem + (smallvec->elem_size * index);
+}
+
+void *smallvec_alloc_elem(smallvec_t *smallvec) {
+    assert(smallvec != NULL);
+
+    if (smallvec->len >= smallvec->cap) {
+        if (smallvec_grow(smallvec)) {
+            return NULL;
+        }
+    }
+
+    return smallvec_get_mem(smallvec) +
+           (smallvec->len++ * smallvec->elem_size);
+}
+
+void *smallvec_push_back(smallvec_t *smallvec, void *item_ptr) {
+    assert(smallvec != NULL);
+    assert(item_ptr != NULL);
+
+    void *dst_mem = smallvec_alloc_elem(smallvec);
+    if (dst_mem == NULL) {
+        return NULL;
+    }
+    memcpy(dst_mem, item_ptr, smallvec->elem_size);
+
+    return dst_mem;
+}
+
+int smallvec_grow(smallvec_t *smallvec) {
+    assert(smallvec != NULL);
+
+    size_t new_cap = smallvec->cap * 2;
+    if (new_cap < SMALLVEC_MIN_HEAP_CAP) {
+        new_cap = SMALLVEC_MIN_HEAP_CAP;
+    }
+
+    // Doubling always leaves the inline buffer, so only the first spill
+    // has to copy out of it
+    assert(new_cap * smallvec->elem_size > SMALLVEC_INLINE_SIZE);
+
+    void *new_mem;
+
+    if (smallvec_is_inline(smallvec)) {
+        new_mem = ALLOC(smallvec->elem_size * new_cap);
+        if (new_mem == NULL) {
+            return -1;
+        }
+        memcpy(new_mem, smallvec->inline_mem,
+               smallvec->elem_size * smallvec->len);
+    } else {
+        new_mem = REALLOC(smallvec->heap_mem, smallvec->elem_size * new_cap);
+        if (new_mem == NULL) {
+            return -1;
+        }
+    }
+
+    smallvec->heap_mem = new_mem;
+    smallvec->cap = new_cap;
+
+    return 0;
+}
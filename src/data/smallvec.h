@@ -0,0 +1,37 @@
+#ifndef SCHC_DATA_SMALLVEC_H_
+#define SCHC_DATA_SMALLVEC_H_
+
+#include <stdlib.h>
+
+#include "allocator.h"
+
+// Bytes of elements a smallvec_t keeps inside itself before spilling
+#define SMALLVEC_INLINE_SIZE (3 * sizeof(void *))
+
+// Vector that keeps its first SMALLVEC_INLINE_SIZE bytes of elements inline
+// and only allocates once they do not fit. Whether the elements are inline is
+// derived from cap, so a smallvec_t can be moved around with memcpy.
+typedef struct smallvec_ {
+    allocator_t *allocator;
+    size_t len;
+    size_t cap;
+    size_t elem_size;
+    union {
+        void *heap_mem;
+        unsigned char inline_mem[SMALLVEC_INLINE_SIZE];
+    };
+} smallvec_t;
+
+int smallvec_init(smallvec_t *smallvec, size_t elem_size);
+int smallvec_init_with_allocator(smallvec_t *smallvec, size_t elem_size,
+                                 allocator_t *allocator);
+void smallvec_destroy(smallvec_t *smallvec);
+
+const void *smallvec_get_ref(const smallvec_t *smallvec, size_t index);
+void *smallvec_alloc_elem(smallvec_t *smallvec);
+void *smallvec_push_back(smallvec_t *smallvec, void *item_ptr);
+void *smallvec_get_mem(smallvec_t *smallvec);
+
+int smallvec_grow(smallvec_t *smallvec);
+
+#endif /*SCHC_DATA_SMALLVEC_H_*/
@@ -0,0 +1,76 @@
+#ifndef SCHC_DATA_STACK_DEFINE_H_
+#define SCHC_DATA_STACK_DEFINE_H_
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "vector_define.h"
+
+// Typed stacks
+//
+// STACK_DEFINE(name, type, alloc) defines vector_name_t as VECTOR_DEFINE does,
+// and on top of it stack_name_t with:
+//
+//   int stack_name_init(stack_name_t *stack, ctx)
+//   void stack_name_destroy(stack_name_t *stack)
+//   int stack_name_push(stack_name_t *stack, type elem)
+//   type *stack_name_peek(stack_name_t *stack)
+//   int stack_name_pop(stack_name_t *stack, type *elem)
+#define STACK_DEFINE_INITIAL_CAP 32
+
+#define STACK_DEFINE(name, type, alloc)                                        \
+    VECTOR_DEFINE(name, type, alloc)                                           \
+                                                                               \
+    typedef struct stack_##name##_ {                                           \
+        vector_##name##_t vector;                                              \
+    } stack_##name##_t;                                                        \
+                                                                               \
+    static inline int stack_##name##_init(stack_##name##_t *stack,             \
+                                          VECTOR_CTX_##alloc *ctx) {           \
+        assert(stack != NULL);                                                 \
+                                                                               \
+        return vector_##name##_init_with_cap(&stack->vector, ctx,              \
+                                             STACK_DEFINE_INITIAL_CAP);        \
+    }                                                                          \
+                                                                               \
+    static inline void stack_##name##_destroy(stack_##name##_t *stack) {       \
+        assert(stack != NULL);                                                 \
+                                                                               \
+        vector_##name##_destroy(&stack->vector);                               \
+    }                                                                          \
+                                                                               \
+    static inline int stack_##name##_push(stack_##name##_t *stack,             \
+                                          type elem) {                         \
+        assert(stack != NULL);                                                 \
+                                                                               \
+        return vector_##name##_push_back(&stack->vector, elem);                \
+    }                                                                          \
+                                                                               \
+    static inline type *stack_##name##_peek(stack_##name##_t *stack) {         \
+        assert(stack != NULL);                                                 \
+                                                                               \
+        if (stack->vector.len == 0) {                                          \
+            return NULL;                                                       \
+        }                                                                      \
+                                                                               \
+        return &stack->vector.mem[stack->vector.len - 1];                      \
+    }                                                                          \
+                                                                               \
+    static inline int stack_##name##_pop(stack_##name##_t *stack,              \
+                                         type *elem) {                         \
+        assert(stack != NULL);                                                 \
+                                                                               \
+        if (stack->vector.len == 0) {                                          \
+            return -1;                                                         \
+        }                                                                      \
+                                                                               \
+        stack->vector.len--;                                                   \
+                                                                               \
+        if (elem != NULL) {                                                    \
+            *elem = stack->vector.mem[stack->vector.len];                      \
+        }                                                                      \
+                                                                               \
+        return 0;                                                              \
+    }
+
+#endif /*SCHC_DATA_STACK_DEFINE_H_*/
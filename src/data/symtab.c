@@ -0,0 +1,173 @@
+#include "symtab.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "hash.h"
+#include "linalloc.h"
+#include "util.h"
+
+#define SYMTAB_INITIAL_CAP 1024
+
+typedef struct symtab_ {
+    int initialized;
+    size_t cap;
+    size_t len;
+    const symbol_t **slots;
+    linalloc_t symbols;
+} symtab_t;
+
+static symtab_t symtab;
+
+// Modules can be parsed on several threads at once, all interning here
+static pthread_mutex_t symtab_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const symbol_t *symtab_intern_locked(const char *str, size_t len, uint64_t h);
+int symtab_init();
+int symtab_grow();
+const symbol_t **symtab_probe(const symbol_t **slots, size_t cap,
+                              const char *str, size_t len, uint64_t h);
+
+const symbol_t *symtab_intern(const char *str) {
+    assert(str != NULL);
+
+    return symtab_intern_len(str, strlen(str));
+}
+
+const symbol_t *symtab_intern_len(const char *str, size_t len) {
+    assert(str != NULL);
+
+    // Hashing needs no lock
+    uint64_t h = hash_bytes(str, len);
+
+    pthread_mutex_lock(&symtab_lock);
+    const symbol_t *sym = symtab_intern_locked(str, len, h);
+    pthread_mutex_unlock(&symtab_lock);
+
+    return sym;
+}
+
+const symbol_t *symtab_intern_locked(const char *str, size_t len, uint64_t h) {
+    int res;
+
+    if (!symtab.initialized) {
+        TRYCR(res, symtab_init(), -1, NULL);
+    }
+
+    const symbol_t **slot = symtab_probe(symtab.slots, symtab.cap, str, len, h);
+
+    if (*slot != NULL) {
+        return *slot;
+    }
+
+    // Symbols know their length, so they need no allocation header
+    size_t size = sizeof(symbol_t) + len + 1;
+    symbol_t *sym;
+    TRYCR(sym, linalloc_alloc_raw(&symtab.symbols, size, sizeof(uint64_t)),
+          NULL, NULL);
+
+    sym->hash = h;
+    sym->len = len;
+    memcpy(sym->str, str, len);
+    sym->str[len] = '\0';
+
+    *slot = sym;
+    symtab.len++;
+
+    if (symtab.len * 2 >= symtab.cap) {
+        TRYCR(res, symtab_grow(), -1, NULL);
+    }
+
+    return sym;
+}
+
+void symtab_destroy() {
+    pthread_mutex_lock(&symtab_lock);
+
+    if (symtab.initialized) {
+        free(symtab.slots);
+        linalloc_destroy(&symtab.symbols);
+
+        memset(&symtab, 0, sizeof(symtab));
+    }
+
+    pthread_mutex_unlock(&symtab_lock);
+}
+
+void symtab_usage(size_t *len, size_t *bytes) {
+    assert(len != NULL);
+    assert(bytes != NULL);
+
+    // Other threads may be interning meanwhile
+    pthread_mutex_lock(&symtab_lock);
+
+    *len = symtab.len;
+    *bytes = 0;
+
+    if (symtab.initialized) {
+        *bytes += symtab.cap * sizeof(const symbol_t *);
+
+        for (size_t i = 0; i < symtab.symbols.blocks.vector.len; ++i) {
+            const linalloc_block_t *block = (const linalloc_block_t *)
+                vector_get_ref(&symtab.symbols.blocks.vector, i);
+
+            *bytes += block->used;
+        }
+    }
+
+    pthread_mutex_unlock(&symtab_lock);
+}
+
+int symtab_init() {
+    int res;
+
+    symtab.cap = SYMTAB_INITIAL_CAP;
+    symtab.len = 0;
+    TRYCR(symtab.slots, calloc(symtab.cap, sizeof(const symbol_t *)), NULL,
+          -1);
+    TRY(res, linalloc_init(&symtab.symbols));
+
+    symtab.initialized = 1;
+
+    return 0;
+}
+
+int symtab_grow() {
+    size_t new_cap = symtab.cap * 2;
+    const symbol_t **new_slots;
+
+    TRYCR(new_slots, calloc(new_cap, sizeof(const symbol_t *)), NULL, -1);
+
+    for (size_t i = 0; i < symtab.cap; ++i) {
+        const symbol_t *sym = symtab.slots[i];
+
+        if (sym != NULL) {
+            *symtab_probe(new_slots, new_cap, sym->str, sym->len, sym->hash) =
+                sym;
+        }
+    }
+
+    free(symtab.slots);
+    symtab.slots = new_slots;
+    symtab.cap = new_cap;
+
+    return 0;
+}
+
+// Returns the slot holding the symbol or the empty slot where it belongs
+const symbol_t **symtab_probe(const symbol_t **slots, size_t cap,
+                              const char *str, size_t len, uint64_t h) {
+    size_t i = h & (cap - 1);
+
+    for (;;) {
+        const symbol_t *sym = slots[i];
+
+        if (sym == NULL || (sym->hash == h && sym->len == len &&
+                            memcmp(sym->str, str, len) == 0)) {
+            return &slots[i];
+        }
+
+        i = (i + 1) & (cap - 1);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef SCHC_DATA_SYMTAB_H_
+#define SCHC_DATA_SYMTAB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// Interned string. There is a single symbol_t per distinct string in the
+// process, so two symbols are equal iff their pointers are. Symbols live
+// until symtab_destroy.
+typedef struct symbol_ {
+    uint64_t hash;
+    size_t len;
+    char str[];
+} symbol_t;
+
+const symbol_t *symtab_intern(const char *str);
+const symbol_t *symtab_intern_len(const char *str, size_t len);
+void symtab_destroy();
+
+// Number of interned symbols and the bytes used to hold and index them
+void symtab_usage(size_t *len, size_t *bytes);
+
+#endif /*SCHC_DATA_SYMTAB_H_*/
@@ -0,0 +1,142 @@
+#ifndef SCHC_DATA_VECTOR_DEFINE_H_
+#define SCHC_DATA_VECTOR_DEFINE_H_
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "linalloc.h"
+
+// Typed vectors
+//
+// VECTOR_DEFINE(name, type, alloc) defines vector_name_t holding elements of
+// type and its functions:
+//
+//   int vector_name_init(vector_name_t *vector, ctx)
+//   int vector_name_init_with_cap(vector_name_t *vector, ctx, size_t cap)
+//   void vector_name_destroy(vector_name_t *vector)
+//   int vector_name_grow(vector_name_t *vector)
+//   type *vector_name_alloc_elem(vector_name_t *vector)
+//   int vector_name_push_back(vector_name_t *vector, type elem)
+//   type vector_name_get(const vector_name_t *vector, size_t index)
+//   type *vector_name_get_ref(vector_name_t *vector, size_t index)
+//
+// Unlike vector_t the element size is known at compile time and alloc picks
+// the allocator statically, so pushes and gets inline down to plain stores
+// and loads. alloc is one of:
+//
+//   default   malloc/realloc/free, ctx is ignored and may be NULL
+//   linalloc  a linalloc_t *, memory is released with the linalloc. Elements
+//             are stored header-free and grow in place while the vector is
+//             the last thing allocated.
+#define VECTOR_CTX_default void
+#define VECTOR_ALLOC_default(ctx, size) malloc(size)
+#define VECTOR_REALLOC_default(ctx, ptr, old_size, size) realloc((ptr), (size))
+#define VECTOR_FREE_default(ctx, mem) free(mem)
+
+#define VECTOR_CTX_linalloc linalloc_t
+#define VECTOR_ALLOC_linalloc(ctx, size)                                       \
+    linalloc_alloc_inline((ctx), (size), LINALLOC_ALIGN)
+#define VECTOR_REALLOC_linalloc(ctx, ptr, old_size, size)                      \
+    linalloc_realloc_raw((ctx), (ptr), (old_size), (size), LINALLOC_ALIGN)
+#define VECTOR_FREE_linalloc(ctx, mem) ((void)(ctx), (void)(mem))
+
+#define VECTOR_DEFINE_INITIAL_CAP 4
+
+#define VECTOR_DEFINE(name, type, alloc)                                       \
+    typedef struct vector_##name##_ {                                          \
+        VECTOR_CTX_##alloc *ctx;                                               \
+        type *mem;                                                             \
+        size_t len;                                                            \
+        size_t cap;                                                            \
+    } vector_##name##_t;                                                       \
+                                                                               \
+    static inline int vector_##name##_init_with_cap(                           \
+        vector_##name##_t *vector, VECTOR_CTX_##alloc *ctx,                    \
+        size_t initial_capacity) {                                             \
+        assert(vector != NULL);                                                \
+        assert(initial_capacity > 0);                                          \
+                                                                               \
+        vector->ctx = ctx;                                                     \
+        vector->len = 0;                                                       \
+        vector->cap = initial_capacity;                                        \
+        vector->mem = (type *)VECTOR_ALLOC_##alloc(                            \
+            ctx, sizeof(type) * initial_capacity);                             \
+        if (vector->mem == NULL) {                                             \
+            return -1;                                                         \
+        }                                                                      \
+                                                                               \
+        return 0;                                                              \
+    }                                                                          \
+                                                                               \
+    static inline int vector_##name##_init(vector_##name##_t *vector,          \
+                                           VECTOR_CTX_##alloc *ctx) {          \
+        return vector_##name##_init_with_cap(vector, ctx,                      \
+                                             VECTOR_DEFINE_INITIAL_CAP);       \
+    }                                                                          \
+                                                                               \
+    static inline void vector_##name##_destroy(vector_##name##_t *vector) {    \
+        assert(vector != NULL);                                                \
+        assert(vector->mem != NULL);                                           \
+                                                                               \
+        VECTOR_FREE_##alloc(vector->ctx, vector->mem);                         \
+    }                                                                          \
+                                                                               \
+    static inline int vector_##name##_grow(vector_##name##_t *vector) {        \
+        type *new_mem = (type *)VECTOR_REALLOC_##alloc(                        \
+            vector->ctx, vector->mem, sizeof(type) * vector->cap,              \
+            sizeof(type) * vector->cap * 2);                                   \
+        if (new_mem == NULL) {                                                 \
+            return -1;                                                         \
+        }                                                                      \
+                                                                               \
+        vector->mem = new_mem;                                                 \
+        vector->cap *= 2;                                                      \
+                                                                               \
+        return 0;                                                              \
+    }                                                                          \
+                                                                               \
+    static inline type *vector_##name##_alloc_elem(                            \
+        vector_##name##_t *vector) {                                           \
+        assert(vector != NULL);                                                \
+                                                                               \
+        if (__builtin_expect(vector->len >= vector->cap, 0)) {                 \
+            if (vector_##name##_grow(vector)) {                                \
+                return NULL;                                                   \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        return &vector->mem[vector->len++];                                    \
+    }                                                                          \
+                                                                               \
+    static inline int vector_##name##_push_back(vector_##name##_t *vector,     \
+                                                type elem) {                   \
+        type *dst = vector_##name##_alloc_elem(vector);                        \
+        if (dst == NULL) {                                                     \
+            return -1;                                                         \
+        }                                                                      \
+                                                                               \
+        *dst = elem;                                                           \
+                                                                               \
+        return 0;                                                              \
+    }                                                                          \
+                                                                               \
+    static inline type vector_##name##_get(const vector_##name##_t *vector,    \
+                                           size_t index) {                     \
+        assert(vector != NULL);                                                \
+        assert(index < vector->len);                                           \
+                                                                               \
+        return vector->mem[index];                                             \
+    }                                                                          \
+                                                                               \
+    static inline type *vector_##name##_get_ref(vector_##name##_t *vector,     \
+                                                size_t index) {                \
+        assert(vector != NULL);                                                \
+                                                                               \
+        if (index >= vector->len) {                                            \
+            return NULL;                                                       \
+        }                                                                      \
+                                                                               \
+        return &vector->mem[index];                                            \
+    }
+
+#endif /*SCHC_DATA_VECTOR_DEFINE_H_*/
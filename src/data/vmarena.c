@@ -0,0 +1,147 @@
+#define _DEFAULT_SOURCE
+
+#include "vmarena.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "util.h"
+
+// Pages are committed this many bytes at a time, which is also the huge page
+// size the reservation gets aligned to
+#define VMARENA_COMMIT_SIZE ((size_t)2 << 20)
+
+int vmarena_commit(vmarena_t *vmarena, size_t size);
+
+int vmarena_init(vmarena_t *vmarena, size_t reserve, vmarena_flags_t flags) {
+    assert(vmarena != NULL);
+
+    if (reserve == 0) {
+        reserve = VMARENA_DEFAULT_RESERVE;
+    }
+
+    reserve = (reserve + VMARENA_COMMIT_SIZE - 1) & ~(VMARENA_COMMIT_SIZE - 1);
+
+    // Over-reserve so base can be aligned for huge pages
+    vmarena->map_size = reserve + VMARENA_COMMIT_SIZE;
+    vmarena->map = mmap(NULL, vmarena->map_size, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (vmarena->map == MAP_FAILED) {
+        return -1;
+    }
+
+    uintptr_t base = ((uintptr_t)vmarena->map + VMARENA_COMMIT_SIZE - 1) &
+                     ~(uintptr_t)(VMARENA_COMMIT_SIZE - 1);
+
+    vmarena->base = (void *)base;
+    vmarena->reserved = reserve;
+    vmarena->committed = 0;
+    vmarena->used = 0;
+    vmarena->last = NULL;
+    vmarena->flags = flags;
+
+#ifdef MADV_HUGEPAGE
+    if (flags & VMARENA_HUGEPAGES) {
+        // Only a hint, the arena works the same without huge pages
+        madvise(vmarena->base, vmarena->reserved, MADV_HUGEPAGE);
+    }
+#endif
+
+    return 0;
+}
+
+void vmarena_destroy(vmarena_t *vmarena) {
+    assert(vmarena != NULL);
+
+    munmap(vmarena->map, vmarena->map_size);
+}
+
+void vmarena_allocator(vmarena_t *vmarena, allocator_t *allocator) {
+    allocator->allocator_data = vmarena;
+    allocator->alloc = (void *)vmarena_alloc;
+    allocator->realloc = (void *)vmarena_realloc;
+    allocator->free = free_noop;
+}
+
+void *vmarena_alloc(vmarena_t *vmarena, size_t size) {
+    assert(vmarena != NULL);
+    assert(size > 0);
+
+    int res;
+
+    size_t start = (vmarena->used + sizeof(size_t) + VMARENA_ALIGN - 1) &
+                   ~(VMARENA_ALIGN - 1);
+
+    if (start + size > vmarena->committed) {
+        TRYCR(res, vmarena_commit(vmarena, start + size), -1, NULL);
+    }
+
+    void *ret = vmarena->base + start;
+    vmarena->used = start + size;
+    vmarena->last = ret;
+
+    // Save alloc size
+    *((size_t *)ret - 1) = size;
+
+    return ret;
+}
+
+void *vmarena_realloc(vmarena_t *vmarena, void *ptr, size_t size) {
+    assert(vmarena != NULL);
+    assert(size > 0);
+
+    int res;
+
+    size_t old_size = *((size_t *)ptr - 1);
+
+    if (size <= old_size) {
+        *((size_t *)ptr - 1) = size;
+
+        return ptr;
+    }
+
+    if (ptr == vmarena->last) {
+        size_t start = ptr - vmarena->base;
+
+        if (start + size > vmarena->committed) {
+            TRYCR(res, vmarena_commit(vmarena, start + size), -1, NULL);
+        }
+
+        vmarena->used = start + size;
+        *((size_t *)ptr - 1) = size;
+
+        return ptr;
+    }
+
+    void *new;
+    TRYCR(new, vmarena_alloc(vmarena, size), NULL, NULL);
+
+    // Copy old data
+    memcpy(new, ptr, old_size);
+
+    return new;
+}
+
+// Makes the first size bytes of the reservation usable
+int vmarena_commit(vmarena_t *vmarena, size_t size) {
+    assert(vmarena != NULL);
+
+    if (size > vmarena->reserved) {
+        return -1;
+    }
+
+    size_t committed =
+        (size + VMARENA_COMMIT_SIZE - 1) & ~(VMARENA_COMMIT_SIZE - 1);
+
+    if (mprotect(vmarena->base + vmarena->committed,
+                 committed - vmarena->committed,
+                 PROT_READ | PROT_WRITE) != 0) {
+        return -1;
+    }
+
+    vmarena->committed = committed;
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef SCHC_DATA_VMARENA_H_
+#define SCHC_DATA_VMARENA_H_
+
+#include <stdlib.h>
+
+#include "allocator.h"
+
+// Address space reserved by vmarena_init when no size is given
+#define VMARENA_DEFAULT_RESERVE ((size_t)1 << 36)
+
+// Alignment of everything returned by vmarena_alloc
+#define VMARENA_ALIGN sizeof(void *)
+
+typedef enum {
+    VMARENA_NONE = 0,
+    VMARENA_HUGEPAGES = 1, // Ask for transparent huge pages
+} vmarena_flags_t;
+
+// Bump allocator over a single virtual memory reservation. The whole range is
+// reserved up front without backing memory, pages are committed as the arena
+// grows and everything is released with one munmap.
+typedef struct vmarena_ {
+    void *map; // Start of the mapping, base may be above it
+    size_t map_size;
+    void *base;
+    size_t reserved;
+    size_t committed;
+    size_t used;
+    void *last; // Most recent allocation, the only one that can grow in place
+    vmarena_flags_t flags;
+} vmarena_t;
+
+int vmarena_init(vmarena_t *vmarena, size_t reserve, vmarena_flags_t flags);
+void vmarena_destroy(vmarena_t *vmarena);
+
+void vmarena_allocator(vmarena_t *vmarena, allocator_t *allocator);
+
+void *vmarena_alloc(vmarena_t *vmarena, size_t size);
+void *vmarena_realloc(vmarena_t *vmarena, void *ptr, size_t size);
+
+#endif /*SCHC_DATA_VMARENA_H_*/
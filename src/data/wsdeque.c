@@ -0,0 +1,154 @@
+#include "wsdeque.h"
+
+#include <assert.h>
+
+#include <util.h>
+
+#define ALLOC(size) ALLOCATOR_ALLOC(deque->allocator, (size))
+#define FREE(mem) ALLOCATOR_FREE(deque->allocator, (mem))
+
+// Orderings follow "Correct and Efficient Work-Stealing for Weak Memory
+// Models" (Lê et al., 2013)
+
+wsdeque_array_t *wsdeque_array_new(wsdeque_t *deque, size_t cap);
+wsdeque_array_t *wsdeque_grow(wsdeque_t *deque, wsdeque_array_t *array,
+                              int64_t top, int64_t bottom);
+
+static inline void *wsdeque_get(const wsdeque_array_t *array, int64_t i) {
+    return __atomic_load_n(&array->items[i & (array->cap - 1)],
+                           __ATOMIC_RELAXED);
+}
+
+static inline void wsdeque_set(wsdeque_array_t *array, int64_t i,
+                               void *item) {
+    __atomic_store_n(&array->items[i & (array->cap - 1)], item,
+                     __ATOMIC_RELAXED);
+}
+
+int wsdeque_init(wsdeque_t *deque) {
+    return wsdeque_init_with_allocator(deque, &default_allocator);
+}
+
+int wsdeque_init_with_allocator(wsdeque_t *deque, allocator_t *allocator) {
+    assert(deque != NULL);
+    assert(allocator != NULL);
+
+    deque->allocator = allocator;
+    deque->top = 0;
+    deque->bottom = 0;
+
+    TRYCR(deque->array, wsdeque_array_new(deque, WSDEQUE_INITIAL_CAP), NULL,
+          -1);
+
+    return 0;
+}
+
+void wsdeque_destroy(wsdeque_t *deque) {
+    assert(deque != NULL);
+
+    wsdeque_array_t *array = deque->array;
+
+    while (array != NULL) {
+        wsdeque_array_t *prev = array->prev;
+        FREE(array);
+        array = prev;
+    }
+}
+
+wsdeque_array_t *wsdeque_array_new(wsdeque_t *deque, size_t cap) {
+    wsdeque_array_t *array;
+
+    TRYCR(array, ALLOC(sizeof(wsdeque_array_t) + cap * sizeof(void *)), NULL,
+          NULL);
+    array->cap = cap;
+    array->prev = NULL;
+
+    return array;
+}
+
+wsdeque_array_t *wsdeque_grow(wsdeque_t *deque, wsdeque_array_t *array,
+                              int64_t top, int64_t bottom) {
+    wsdeque_array_t *grown;
+
+    TRYCR(grown, wsdeque_array_new(deque, array->cap * 2), NULL, NULL);
+    grown->prev = array;
+
+    for (int64_t i = top; i < bottom; ++i) {
+        wsdeque_set(grown, i, wsdeque_get(array, i));
+    }
+
+    __atomic_store_n(&deque->array, grown, __ATOMIC_RELEASE);
+
+    return grown;
+}
+
+int wsdeque_push(wsdeque_t *deque, void *item) {
+    assert(deque != NULL);
+
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    wsdeque_array_t *array = __atomic_load_n(&deque->array, __ATOMIC_RELAXED);
+
+    if (bottom - top > (int64_t)array->cap - 1) {
+        TRYCR(array, wsdeque_grow(deque, array, top, bottom), NULL, -1);
+    }
+
+    wsdeque_set(array, bottom, item);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+void *wsdeque_pop(wsdeque_t *deque) {
+    assert(deque != NULL);
+
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    wsdeque_array_t *array = __atomic_load_n(&deque->array, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        // Empty
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    void *item = wsdeque_get(array, bottom);
+
+    if (top == bottom) {
+        // Last item, thieves may be after it too
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            item = NULL;
+        }
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return item;
+}
+
+void *wsdeque_steal(wsdeque_t *deque) {
+    assert(deque != NULL);
+
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom) {
+        return NULL;
+    }
+
+    wsdeque_array_t *array = __atomic_load_n(&deque->array, __ATOMIC_ACQUIRE);
+    void *item = wsdeque_get(array, top);
+
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+
+    return item;
+}
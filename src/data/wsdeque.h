@@ -0,0 +1,42 @@
+#ifndef SCHC_DATA_WSDEQUE_H_
+#define SCHC_DATA_WSDEQUE_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "allocator.h"
+
+#define WSDEQUE_INITIAL_CAP 64
+
+typedef struct wsdeque_array_ {
+    size_t cap;
+    struct wsdeque_array_ *prev; // Outgrown array, kept for late thieves
+    void *items[];
+} wsdeque_array_t;
+
+// Chase-Lev work-stealing deque
+//
+// The owning thread pushes and pops items at the bottom, any other thread may
+// steal them from the top. Only a pop racing a steal for the last item needs
+// a CAS. The array doubles when full. Outgrown arrays stay allocated until
+// wsdeque_destroy because a thief may still be reading one.
+typedef struct wsdeque_ {
+    allocator_t *allocator;
+    int64_t top;
+    int64_t bottom;
+    wsdeque_array_t *array;
+} wsdeque_t;
+
+int wsdeque_init(wsdeque_t *deque);
+int wsdeque_init_with_allocator(wsdeque_t *deque, allocator_t *allocator);
+void wsdeque_destroy(wsdeque_t *deque);
+
+// Owner only
+int wsdeque_push(wsdeque_t *deque, void *item);
+void *wsdeque_pop(wsdeque_t *deque);
+
+// Any thread. Returns NULL when empty or when it lost a race, so callers
+// should just move on to the next victim.
+void *wsdeque_steal(wsdeque_t *deque);
+
+#endif /*SCHC_DATA_WSDEQUE_H_*/
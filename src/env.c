@@ -6,12 +6,38 @@
 
 #include "util.h"
 
-#define ENV_INITIAL_CAPACITY 1024
+#define ENV_INITIAL_CAPACITY HASHMAP_SMALL_CAP
+// Symbols env_get_many looks up per batch
+#define ENV_BATCH 16
 
 #define ALLOC(size) ALLOCATOR_ALLOC(env->allocator, (size))
 #define FREE(mem) ALLOCATOR_FREE(env->allocator, (mem))
 
-int env_put_expr_no_alloc(env_t *env, const char *symbol, core_expr_t *owned_expr);
+// A binding put while a scope was pushed
+typedef struct env_undo_ {
+    const symbol_t *symbol;
+    core_expr_t *expr;
+    core_expr_t *prev; // Binding it replaced in a hashmap env, if any
+} env_undo_t;
+
+typedef struct env_mark_ {
+    size_t undo_len;
+    hamt_mark_t map; // Persistent envs just rewind their map
+} env_mark_t;
+
+struct env_scopes_ {
+    vector_t /* env_mark_t */ marks;
+    vector_t /* env_undo_t */ undo;
+    vector_t /* core_expr_t* */ popped; // Unbound, but maybe still pointed to
+};
+
+int env_put_expr_no_alloc(env_t *env, const symbol_t *symbol,
+                          core_expr_t *owned_expr);
+void env_destroy_hashmap(env_t *env);
+void env_destroy_persistent(env_t *env);
+core_expr_t *env_get_persistent(env_t *env, const symbol_t *symbol);
+core_expr_t *env_get_upper(env_t *env, const symbol_t *symbol);
+int env_log_put(env_t *env, const symbol_t *symbol, core_expr_t *owned_expr);
 
 int env_init(env_t *env) {
     return env_init_with_allocator(env, &default_allocator);
@@ -25,6 +51,8 @@ int env_init_with_allocator(env_t *env, allocator_t *allocator) {
 
     env->upper_scope = NULL;
     env->allocator = allocator;
+    env->kind = ENV_HASHMAP;
+    env->scopes = NULL;
 
     TRY(res, hashmap_init_with_cap_and_allocator(
                  &env->scope, sizeof(core_expr_t *), ENV_INITIAL_CAPACITY,
@@ -33,23 +61,93 @@ int env_init_with_allocator(env_t *env, allocator_t *allocator) {
     return 0;
 }
 
+int env_init_persistent(env_t *env, allocator_t *allocator) {
+    assert(env != NULL);
+    assert(allocator != NULL);
+
+    int res;
+
+    env->upper_scope = NULL;
+    env->allocator = allocator;
+    env->kind = ENV_PERSISTENT;
+    env->scopes = NULL;
+
+    TRY(res, hamt_init_with_allocator(&env->map, allocator));
+
+    return 0;
+}
+
+// Opens a scope of the same kind and allocator as upper_scope
+int env_init_scope(env_t *env, env_t *upper_scope) {
+    assert(env != NULL);
+    assert(upper_scope != NULL);
+
+    int res;
+
+    if (upper_scope->kind == ENV_PERSISTENT) {
+        TRY(res, env_init_persistent(env, upper_scope->allocator));
+    } else {
+        TRY(res, env_init_with_allocator(env, upper_scope->allocator));
+    }
+
+    env->upper_scope = upper_scope;
+
+    return 0;
+}
+
+static const vector_t /* const symbol_t * */ *env_keys(const env_t *env) {
+    if (env->kind == ENV_PERSISTENT) {
+        return hamt_keys(&env->map);
+    } else {
+        return hashmap_keys(&env->scope);
+    }
+}
+
+void env_destroy_persistent(env_t *env) {
+    const vector_t *keys = hamt_keys(&env->map);
+
+    // Upper scopes are destroyed after this one, so the nodes shared from
+    // them outlive it
+    for (size_t i = 0; i < keys->len; ++i) {
+        const symbol_t *key = *(const symbol_t **)vector_get_ref(keys, i);
+        core_expr_t *expr = hamt_get_sym(&env->map, key);
+
+        core_destroy(expr, env->allocator);
+        FREE(expr);
+    }
+
+    hamt_destroy(&env->map);
+}
+
 void env_destroy(env_t *env) {
     assert(env != NULL);
 
-    size_t vlen = env->scope.cap;
+    if (env->scopes != NULL) {
+        vector_t *popped = &env->scopes->popped;
 
-    for (size_t i = 0; i < vlen; ++i) {
-        hashmap_location_t *loc = hashmap_get_entry(&env->scope, i, NULL);
+        while (env->scopes->marks.len > 0) {
+            env_pop_scope(env);
+        }
 
-        core_expr_t *expr = *(core_expr_t **)loc->data;
+        for (size_t i = 0; i < popped->len; ++i) {
+            core_expr_t *expr = *(core_expr_t **)vector_get_ref(popped, i);
 
-        if (loc != NULL && loc->key != NULL) {
             core_destroy(expr, env->allocator);
             FREE(expr);
         }
+
+        vector_destroy(&env->scopes->marks);
+        vector_destroy(&env->scopes->undo);
+        vector_destroy(popped);
+        FREE(env->scopes);
+        env->scopes = NULL;
     }
 
-    hashmap_destroy(&env->scope);
+    if (env->kind == ENV_PERSISTENT) {
+        env_destroy_persistent(env);
+    } else {
+        env_destroy_hashmap(env);
+    }
 
     if (env->upper_scope != NULL) {
         env_destroy(env->upper_scope);
@@ -57,11 +155,133 @@ void env_destroy(env_t *env) {
     }
 }
 
-core_expr_t *env_get_expr(env_t *env, const char *symbol) {
+void env_destroy_hashmap(env_t *env) {
+    const vector_t *keys = hashmap_keys(&env->scope);
+
+    for (size_t i = 0; i < keys->len; ++i) {
+        const symbol_t *key = *(const symbol_t **)vector_get_ref(keys, i);
+        core_expr_t *expr =
+            *(core_expr_t **)hashmap_get_sym(&env->scope, key);
+
+        core_destroy(expr, env->allocator);
+        FREE(expr);
+    }
+
+    hashmap_destroy(&env->scope);
+}
+
+int env_push_scope(env_t *env) {
+    assert(env != NULL);
+
+    int res;
+
+    if (env->scopes == NULL) {
+        TRYCR(env->scopes, ALLOC(sizeof(struct env_scopes_)), NULL, -1);
+        TRY(res, vector_init_with_allocator(&env->scopes->marks,
+                                            sizeof(env_mark_t),
+                                            env->allocator));
+        TRY(res, vector_init_with_allocator(&env->scopes->undo,
+                                            sizeof(env_undo_t),
+                                            env->allocator));
+        TRY(res, vector_init_with_allocator(&env->scopes->popped,
+                                            sizeof(core_expr_t *),
+                                            env->allocator));
+    }
+
+    env_mark_t *mark;
+    TRYCR(mark, vector_alloc_elem(&env->scopes->marks), NULL, -1);
+
+    mark->undo_len = env->scopes->undo.len;
+    if (env->kind == ENV_PERSISTENT) {
+        mark->map = hamt_mark(&env->map);
+    }
+
+    return 0;
+}
+
+// Unbinds the symbols put since the matching push, newest first so each one
+// gets back the binding it replaced. Expressions generated inside the scope
+// may still point at the popped ones, so those are only destroyed along with
+// the env. Scopes opened on top of this env since then must have been
+// destroyed already.
+void env_pop_scope(env_t *env) {
+    assert(env != NULL);
+    assert(env->scopes != NULL && env->scopes->marks.len > 0);
+
+    vector_t *undo = &env->scopes->undo;
+    env_mark_t mark = *(const env_mark_t *)vector_get_ref(
+        &env->scopes->marks, env->scopes->marks.len - 1);
+
+    env->scopes->marks.len--;
+
+    while (undo->len > mark.undo_len) {
+        env_undo_t entry =
+            *(const env_undo_t *)vector_get_ref(undo, undo->len - 1);
+
+        undo->len--;
+
+        // Keeping it can only fail to grow the vector, then it leaks
+        vector_push_back(&env->scopes->popped, &entry.expr);
+
+        if (env->kind == ENV_PERSISTENT) {
+            continue;
+        }
+
+        // Neither can fail, the key is already in the map
+        if (entry.prev != NULL) {
+            hashmap_put_sym(&env->scope, entry.symbol, &entry.prev);
+        } else {
+            hashmap_remove_sym(&env->scope, entry.symbol, NULL);
+        }
+    }
+
+    if (env->kind == ENV_PERSISTENT) {
+        hamt_rewind(&env->map, mark.map);
+    }
+}
+
+// Persistent lookups need to look at an upper scope again only when it was
+// put into after it was shared
+core_expr_t *env_get_persistent(env_t *env, const symbol_t *symbol) {
+    core_expr_t *expr = hamt_get_sym(&env->map, symbol);
+
+    if (expr != NULL) {
+        return expr;
+    }
+
+    return env_get_upper(env, symbol);
+}
+
+// Looks up a symbol the scope itself does not have in its upper scopes
+core_expr_t *env_get_upper(env_t *env, const symbol_t *symbol) {
+    if (env->kind == ENV_HASHMAP) {
+        return env->upper_scope != NULL
+                   ? env_get_expr(env->upper_scope, symbol)
+                   : NULL;
+    }
+
+    for (env_t *scope = env; scope->upper_scope != NULL;
+         scope = scope->upper_scope) {
+        env_t *upper = scope->upper_scope;
+
+        if (upper->kind != ENV_PERSISTENT ||
+            upper->map.root != scope->map.shared) {
+            return env_get_expr(upper, symbol);
+        }
+    }
+
+    return NULL;
+}
+
+core_expr_t *env_get_expr(env_t *env, const symbol_t *symbol) {
     assert(env != NULL);
     assert(symbol != NULL);
 
-    core_expr_t **expr = (core_expr_t **)hashmap_get(&env->scope, symbol);
+    if (env->kind == ENV_PERSISTENT) {
+        return env_get_persistent(env, symbol);
+    }
+
+    core_expr_t **expr = (core_expr_t **)hashmap_get_sym(&env->scope, symbol);
 
     if (expr == NULL) {
         if (env->upper_scope) {
@@ -74,40 +294,114 @@ core_expr_t *env_get_expr(env_t *env, const char *symbol) {
     }
 }
 
-int env_put_expr(env_t *env, const char *symbol, core_expr_t *expr) {
+// Looks up n symbols, setting out[i] as env_get_expr(symbols[i]) would. The
+// lookups of a batch are done together so their cache misses overlap, which
+// pays off when resolving many names at once.
+void env_get_many(env_t *env, const symbol_t *const *symbols, size_t n,
+                  core_expr_t **out) {
+    assert(env != NULL);
+    assert(symbols != NULL || n == 0);
+    assert(out != NULL || n == 0);
+
+    void *found[ENV_BATCH];
+
+    for (size_t start = 0; start < n; start += ENV_BATCH) {
+        size_t len = n - start > ENV_BATCH ? ENV_BATCH : n - start;
+
+        if (env->kind == ENV_PERSISTENT) {
+            hamt_get_many(&env->map, symbols + start, len, found);
+        } else {
+            hashmap_get_many(&env->scope, symbols + start, len, found);
+        }
+
+        for (size_t k = 0; k < len; ++k) {
+            if (found[k] == NULL) {
+                out[start + k] = env_get_upper(env, symbols[start + k]);
+            } else if (env->kind == ENV_PERSISTENT) {
+                out[start + k] = found[k];
+            } else {
+                out[start + k] = *(core_expr_t **)found[k];
+            }
+        }
+    }
+}
+
+int env_put_expr(env_t *env, const symbol_t *symbol, core_expr_t *expr) {
     assert(env != NULL);
     assert(symbol != NULL);
     assert(expr != NULL);
 
     core_expr_t *owned_expr;
-    TRYCR(owned_expr, ALLOC(sizeof(core_expr_t)), NULL, -1);
+    TRYCR(owned_expr, core_alloc(env->allocator), NULL, -1);
+
+    core_id_t id = owned_expr->id;
     *owned_expr = *expr;
+    owned_expr->id = id;
 
     return env_put_expr_no_alloc(env, symbol, owned_expr);
 }
 
-int env_put_expr_no_alloc(env_t *env, const char *symbol, core_expr_t *owned_expr) {
+int env_put_expr_no_alloc(env_t *env, const symbol_t *symbol,
+                          core_expr_t *owned_expr) {
     assert(env != NULL);
     assert(symbol != NULL);
     assert(owned_expr != NULL);
 
     int res;
 
-    TRY(res, hashmap_put(&env->scope, symbol, &owned_expr));
+    if (env->scopes != NULL && env->scopes->marks.len > 0) {
+        TRY(res, env_log_put(env, symbol, owned_expr));
+    }
+
+    if (env->kind == ENV_HASHMAP) {
+        TRY(res, hashmap_put_sym(&env->scope, symbol, &owned_expr));
+
+        return 0;
+    }
+
+    // Take over everything the upper scopes hold by now on the first put
+    if (env->map.keys.len == 0 && env->upper_scope != NULL &&
+        env->upper_scope->kind == ENV_PERSISTENT) {
+        hamt_share(&env->map, &env->upper_scope->map);
+    }
+
+    TRY(res, hamt_put_sym(&env->map, symbol, owned_expr));
+
+    return 0;
+}
+
+// Records a put inside a pushed scope so popping it can undo it
+int env_log_put(env_t *env, const symbol_t *symbol, core_expr_t *owned_expr) {
+    env_undo_t *entry;
+    TRYCR(entry, vector_alloc_elem(&env->scopes->undo), NULL, -1);
+
+    entry->symbol = symbol;
+    entry->expr = owned_expr;
+    entry->prev = NULL;
+
+    if (env->kind == ENV_HASHMAP) {
+        core_expr_t **prev =
+            (core_expr_t **)hashmap_get_sym(&env->scope, symbol);
+
+        if (prev != NULL) {
+            entry->prev = *prev;
+        }
+    }
 
     return 0;
 }
 
-int env_list_scope(const env_t *env, vector_t /* const char * */ *out_scope,
-                   int recursive) {
+int env_list_scope(const env_t *env,
+                   vector_t /* const symbol_t * */ *out_scope, int recursive) {
     assert(env != NULL);
     assert(out_scope != NULL);
 
     int res = 0;
+    const vector_t *keys = env_keys(env);
 
-    for (size_t i = 0; i < env->scope.keys.len; i++) {
-        const char *scope_var =
-            *(const char **)vector_get_ref(&env->scope.keys, i);
+    for (size_t i = 0; i < keys->len; i++) {
+        const symbol_t *scope_var =
+            *(const symbol_t **)vector_get_ref(keys, i);
 
         void *memres;
         TRYCR(memres, vector_push_back(out_scope, &scope_var), NULL, -1);
@@ -126,15 +420,16 @@ int env_print_scope(const env_t *env, int recursive, FILE *fp) {
 
     int res = 0;
 
-    vector_t /* const char * */ scope;
-    vector_init(&scope, sizeof(const char *));
+    vector_t /* const symbol_t * */ scope;
+    vector_init(&scope, sizeof(const symbol_t *));
 
     env_list_scope(env, &scope, recursive);
 
     for (size_t i = 0; i < scope.len; ++i) {
-        const char *varname = *(const char **)vector_get_ref(&scope, i);
+        const symbol_t *varname =
+            *(const symbol_t **)vector_get_ref(&scope, i);
 
-        TRYNEG(res, fprintf(fp, "%s\n", varname));
+        TRYNEG(res, fprintf(fp, "%s\n", varname->str));
     }
 
     vector_destroy(&scope);
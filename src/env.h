@@ -5,25 +5,58 @@
 #include <stdio.h>
 
 #include "data/allocator.h"
+#include "data/hamt.h"
 #include "data/hashmap.h"
+#include "data/symtab.h"
 #include "data/vector.h"
 
+// A hashmap env only holds its own scope, so a lookup walks up the scopes
+// until one has the symbol.
+//
+// A persistent env shares the map of its upper scope when it is first put
+// into and adds its own symbols on top, so symbols of all the scopes it was
+// opened in are found with a single lookup. Symbols put into an upper scope
+// after that are still found by falling back to it.
+typedef enum env_kind_ {
+    ENV_HASHMAP,
+    ENV_PERSISTENT,
+} env_kind_t;
+
+// env_push_scope opens a nested scope inside the env itself instead of a new
+// env, and env_pop_scope unbinds everything put since, restoring the bindings
+// it shadowed. The unbound expressions live until env_destroy. Blocks such as
+// let then reuse the map of the enclosing scope instead of allocating their
+// own.
+struct env_scopes_;
+
 typedef struct env_ {
     struct env_ *upper_scope;
     allocator_t *allocator;
-    hashmap_t /* core_expr_t* */ scope;
+    env_kind_t kind;
+    struct env_scopes_ *scopes; // Pushed scopes, NULL until the first push
+    union {
+        hashmap_t /* core_expr_t* */ scope;
+        hamt_t /* core_expr_t* */ map;
+    };
 } env_t;
 
 #include "core.h"
 
 int env_init(env_t *env);
 int env_init_with_allocator(env_t *env, allocator_t *allocator);
+int env_init_persistent(env_t *env, allocator_t *allocator);
+int env_init_scope(env_t *env, env_t *upper_scope);
 void env_destroy(env_t *env);
 
-core_expr_t *env_get_expr(env_t *env, const char *symbol);
-int env_put_expr(env_t *env, const char *symbol, core_expr_t *expr);
-int env_list_scope(const env_t *env, vector_t /* const char * */ *out_scope,
-                   int recursive);
+int env_push_scope(env_t *env);
+void env_pop_scope(env_t *env);
+
+core_expr_t *env_get_expr(env_t *env, const symbol_t *symbol);
+void env_get_many(env_t *env, const symbol_t *const *symbols, size_t n,
+                  core_expr_t **out);
+int env_put_expr(env_t *env, const symbol_t *symbol, core_expr_t *expr);
+int env_list_scope(const env_t *env,
+                   vector_t /* const symbol_t * */ *out_scope, int recursive);
 
 int env_print_scope(const env_t *env, int recursive, FILE *fp);
 
@@ -3,6 +3,7 @@
 #include <assert.h>
 
 #include "../data/allocator.h"
+#include "../data/symtab.h"
 #include "../env.h"
 #include "../util.h"
 
@@ -12,60 +13,70 @@ int intrinsics_load(env_t *env) {
     int res;
 
     core_expr_t expr;
+    const symbol_t *sym;
 
     expr.name = "putStrLn";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "putStrLn";
 
-    TRY(res, env_put_expr(env, "putStrLn", &expr));
+    TRYCR(sym, symtab_intern("putStrLn"), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     expr.name = "show";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "show";
 
-    TRY(res, env_put_expr(env, "show", &expr));
+    TRYCR(sym, symtab_intern("show"), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     expr.name = "div";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "div";
 
-    TRY(res, env_put_expr(env, "div", &expr));
+    TRYCR(sym, symtab_intern("div"), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     expr.name = "+";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "plus";
 
-    TRY(res, env_put_expr(env, "+", &expr));
+    TRYCR(sym, symtab_intern("+"), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     expr.name = "-";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "minus";
 
-    TRY(res, env_put_expr(env, "-", &expr));
+    TRYCR(sym, symtab_intern("-"), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     expr.name = "*";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "mult";
 
-    TRY(res, env_put_expr(env, "*", &expr));
+    TRYCR(sym, symtab_intern("*"), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     expr.name = ">=";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "gte";
 
-    TRY(res, env_put_expr(env, ">=", &expr));
+    TRYCR(sym, symtab_intern(">="), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     expr.name = "<=";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "lte";
 
-    TRY(res, env_put_expr(env, "<=", &expr));
+    TRYCR(sym, symtab_intern("<="), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     expr.name = "==";
     expr.form = CORE_INTRINSIC;
     expr.intrinsic.name = "eq";
 
-    TRY(res, env_put_expr(env, "==", &expr));
+    TRYCR(sym, symtab_intern("=="), NULL, -1);
+    TRY(res, env_put_expr(env, sym, &expr));
 
     return res;
 }
\ No newline at end of file
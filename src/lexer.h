@@ -2,14 +2,14 @@
 #define SCHC_LEXER_H_
 
 #include <stdio.h>
+#include <stdlib.h>
 
-extern int yylex();
-extern int yylex_destroy();
-extern char *yytext;
-extern FILE *yyin;
-extern FILE *yyout;
-extern int yylineno;
-extern int yycolumn;
+// Flex lexer from gen_lexer.l. All of its state lives in here, so several
+// files can be lexed at once.
+typedef struct lexer_ {
+    void *scanner; // yyscan_t
+    int column;    // Counted like yylineno, flex has no column of its own
+} lexer_t;
 
 typedef enum token_ {
     TOK_ERROR = -1,
@@ -52,6 +52,16 @@ typedef enum token_ {
     TOK_UNIT,
 } token_t;
 
+int lexer_init(lexer_t *lexer, FILE *input);
+int lexer_init_str(lexer_t *lexer, const char *str);
+void lexer_destroy(lexer_t *lexer);
+
+int lexer_next(lexer_t *lexer);
+const char *lexer_text(const lexer_t *lexer);
+size_t lexer_len(const lexer_t *lexer);
+int lexer_line(const lexer_t *lexer);
+int lexer_column(const lexer_t *lexer);
+
 const char *strtoken(int token);
 
 #endif /*SCHC_LEXER_H_*/
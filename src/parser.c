@@ -26,6 +26,12 @@
         }                                                                      \
     } while (0);
 
+// Where a failed speculative production goes back to
+typedef struct parser_mark_ {
+    linalloc_mark_t arena;
+    size_t cursor;
+} parser_mark_t;
+
 int accept(parser_t *parser, token_t token);
 int maybe(int res);
 int soft(int res);
@@ -35,13 +41,13 @@ int operator(parser_t *parser);
 
 int root(parser_t *parser, ast_t *node);
 int module(parser_t *parser, ast_t *node);
-int exports(parser_t *parser, vector_t /*ast_export_t*/ *exports);
+int exports(parser_t *parser, smallvec_t /*ast_export_t*/ *exports);
 int export(parser_t *parser, ast_export_t *ex);
 int body(parser_t *parser, ast_t *node);
 int declaration(parser_t *parser, ast_t *node);
-int function(parser_t *parser, char *decl_name, ast_t *node);
-int value(parser_t *parser, char *decl_name, ast_t *node);
-int has_type(parser_t *parser, char *decl_name, ast_t *node);
+int function(parser_t *parser, const symbol_t *decl_name, ast_t *node);
+int value(parser_t *parser, const symbol_t *decl_name, ast_t *node);
+int has_type(parser_t *parser, const symbol_t *decl_name, ast_t *node);
 
 int identable(parser_t *parser, vector_t /*ast_t*/ *nodes,
               int (*element_parser)(parser_t *, ast_t *));
@@ -64,42 +70,41 @@ int string(parser_t *parser, ast_t *node);
 
 int bindings(parser_t *parser, vector_t *binds);
 
-void open_indent(parser_t *parser);
-void open_free_indent(parser_t *parser);
-void continue_indent(parser_t *parser);
-void close_indent(parser_t *parser);
+parser_mark_t parser_mark(parser_t *parser);
+void parser_rewind(parser_t *parser, parser_mark_t mark);
 
 int parser_init(parser_t *parser) {
     assert(parser != NULL);
 
-    int res;
-
-    parser->token = -1;
-    parser->ptext = NULL;
-    parser->flags = PARSER_NONE;
-    TRY(res, stack_init(&parser->indent_stack, sizeof(int)));
+    parser->tokens = NULL;
+    parser->cursor = 0;
+    parser->last = 0;
+    parser->psym = NULL;
+    parser->arena = NULL;
 
     return 0;
 }
 
-void parser_destroy(parser_t *parser) {
-    assert(parser != NULL);
+void parser_destroy(parser_t *parser) { assert(parser != NULL); }
 
-    if (parser->ptext != NULL) {
-        FREE(parser->ptext);
-    }
+// When the allocator given to parser_parse is backed by arena, failed
+// speculative productions give their memory back to it
+void parser_set_arena(parser_t *parser, linalloc_t *arena) {
+    assert(parser != NULL);
 
-    stack_destroy(&parser->indent_stack);
+    parser->arena = arena;
 }
 
-int parser_parse(parser_t *parser, ast_t *root, allocator_t *allocator) {
+int parser_parse(parser_t *parser, const token_stream_t *tokens, ast_t *root,
+                 allocator_t *allocator) {
     assert(parser != NULL);
+    assert(tokens != NULL && tokens->len > 0);
     assert(root != NULL);
     assert(allocator != NULL);
 
+    parser->tokens = tokens;
+    parser->cursor = 0;
     parser->allocator = allocator;
-    parser->token = yylex();
-    TRYCR(parser->ptext, STRALLOC(yytext), NULL, -1);
 
     int res = module(parser, root);
 
@@ -112,12 +117,44 @@ int parser_parse(parser_t *parser, ast_t *root, allocator_t *allocator) {
     return 0;
 }
 
-char *parser_get_text(parser_t *parser) {
+// Kind of the token k after the current one, the end stays the end
+token_t parser_peek(const parser_t *parser, size_t k) {
+    assert(parser != NULL);
+    assert(parser->tokens != NULL);
+
+    size_t i = parser->cursor + k;
+
+    if (i >= parser->tokens->len) {
+        i = parser->tokens->len - 1;
+    }
+
+    return parser->tokens->kinds[i];
+}
+
+// Where the current token starts
+void parser_location(const parser_t *parser, int *line, int *column) {
+    assert(parser != NULL);
+    assert(parser->tokens != NULL);
+    assert(line != NULL);
+    assert(column != NULL);
+
+    *line = parser->tokens->lines[parser->cursor];
+    *column = parser->tokens->columns[parser->cursor];
+}
+
+// Text of the last accepted token, only interned when asked for
+const symbol_t *parser_get_symbol(parser_t *parser) {
     assert(parser != NULL);
 
-    char *text = parser->ptext;
-    parser->ptext = NULL;
-    return text;
+    if (parser->psym == NULL) {
+        const token_stream_t *tokens = parser->tokens;
+
+        parser->psym =
+            symtab_intern_len(tokens->text + tokens->offsets[parser->last],
+                              tokens->lens[parser->last]);
+    }
+
+    return parser->psym;
 }
 
 // Parsing
@@ -126,37 +163,20 @@ int accept(parser_t *parser, token_t token) {
     assert(parser != NULL);
     assert(token != 0);
 
-    int indent = yycolumn - strlen(yytext);
-
-    if (parser->token == token) {
-        if (parser->flags & PARSER_NEW_INDENT_ACCEPTED) {
-            int ret;
-            parser->flags &= !PARSER_NEW_INDENT_ACCEPTED;
-            TRY(ret, stack_push(&parser->indent_stack, &indent));
-            printf("Indent: %d\n", indent);
-        } else {
-            const int *indent_level = stack_peek(&parser->indent_stack);
-            if (indent_level != NULL) {
-                if (indent < *indent_level) {
-                    return -1;
-                } else if (indent == *indent_level) {
-                    if (parser->flags & PARSER_CONTINUE_INDENT) {
-                        parser->flags &= !PARSER_CONTINUE_INDENT;
-                    } else {
-                        return -1;
-                    }
-                }
-            }
-        }
+    const token_stream_t *tokens = parser->tokens;
+    size_t i = parser->cursor;
 
-        if (parser->ptext != NULL) {
-            FREE(parser->ptext);
-            parser->ptext = NULL;
-        }
+    if (tokens->kinds[i] == token) {
+        printf("%-20s%.*s\n", strtoken(token), (int)tokens->lens[i],
+               tokens->text + tokens->offsets[i]);
 
-        printf("%-20s%s\n", strtoken(token), yytext);
-        TRYCR(parser->ptext, STRALLOC(yytext), NULL, -1);
-        parser->token = yylex();
+        parser->last = i;
+        parser->psym = NULL;
+
+        // The end token is never moved past
+        if (i + 1 < tokens->len) {
+            parser->cursor++;
+        }
 
         return token;
     }
@@ -166,64 +186,50 @@ int accept(parser_t *parser, token_t token) {
 
 int maybe(int res) { return res == 0 ? TOK_NO_TOK : res; }
 
-int soft(int res) {
-    if (res == -1) {
-        return 0;
-    }
-
-    return res;
-}
-
-int hard(int res) {
-    if (res <= 0) {
-        return -1;
-    }
-
-    return res;
-}
+// Speculation
+//
+// A production that fails softly may already have allocated and accepted
+// tokens. Taking a mark before it and rewinding on failure keeps the arena
+// from growing with every attempted parse and moves back to the token it
+// started at. Nothing allocated after the mark may still be reachable when
+// rewinding, so marks go after any growth of enclosing vectors.
 
-void no_indent(parser_t *parser) {
+parser_mark_t parser_mark(parser_t *parser) {
     assert(parser != NULL);
 
-    int no_indent = -1;
-    stack_push(&parser->indent_stack, &no_indent);
-}
+    parser_mark_t mark = {{0, 0, 0}, parser->cursor};
 
-void open_indent(parser_t *parser) {
-    assert(parser != NULL);
+    if (parser->arena != NULL) {
+        mark.arena = linalloc_mark(parser->arena);
+    }
 
-    parser->flags |= PARSER_NEW_INDENT_ACCEPTED;
+    return mark;
 }
 
-void open_free_indent(parser_t *parser) {
+void parser_rewind(parser_t *parser, parser_mark_t mark) {
     assert(parser != NULL);
 
-    int free_indent = -1;
+    parser->cursor = mark.cursor;
 
-    stack_push(&parser->indent_stack, &free_indent);
-
-    printf("Indent: free\n");
+    if (parser->arena != NULL) {
+        linalloc_rewind(parser->arena, mark.arena);
+    }
 }
 
-void continue_indent(parser_t *parser) {
-    assert(parser != NULL);
+int soft(int res) {
+    if (res == -1) {
+        return 0;
+    }
 
-    parser->flags |= PARSER_CONTINUE_INDENT;
+    return res;
 }
 
-void close_indent(parser_t *parser) {
-    assert(parser != NULL);
-
-    stack_pop(&parser->indent_stack, NULL);
-
-    int *curr_indent = (int *)stack_peek(&parser->indent_stack);
-    if (curr_indent == NULL) {
-        printf("Indent: NULL\n");
-    } else {
-        printf("Indent: %d\n", *curr_indent);
+int hard(int res) {
+    if (res <= 0) {
+        return -1;
     }
 
-    parser->flags &= !PARSER_CONTINUE_INDENT;
+    return res;
 }
 
 int identable(parser_t *parser, vector_t /*ast_t*/ *nodes,
@@ -234,37 +240,25 @@ int identable(parser_t *parser, vector_t /*ast_t*/ *nodes,
 
     int res;
 
-    TRYP(res, maybe(soft(accept(parser, '{'))));
+    // Layout is resolved in the token stream, implicit blocks have braces too
+    TRYP(res, soft(accept(parser, '{')));
 
-    if (res != TOK_NO_TOK) {
-        open_free_indent(parser);
-        while (res != TOK_NO_TOK) {
-            ast_t *new_node;
-            TRYCR(new_node, (ast_t *)vector_alloc_elem(nodes), NULL, -1);
-            TRYP(res, element_parser(parser, new_node));
-            TRYP(res, maybe(soft(accept(parser, ';'))));
+    for (;;) {
+        TRYP(res, maybe(soft(accept(parser, '}'))));
+        if (res != TOK_NO_TOK) {
+            break;
         }
 
-        TRYP(res, accept(parser, '}'));
-        close_indent(parser);
-    } else {
-        open_indent(parser);
-
-        for (;;) {
-            ast_t *new_node;
-            TRYCR(new_node, (ast_t *)vector_alloc_elem(nodes), NULL, -1);
-            TRYP(res, maybe(soft(element_parser(parser, new_node))));
-
-            if (res == TOK_NO_TOK) {
-                break;
-            } else {
-                continue_indent(parser);
-            }
-        };
+        ast_t *new_node;
+        TRYCR(new_node, (ast_t *)vector_alloc_elem(nodes), NULL, -1);
+        // An element that does not parse is an error, not the end of the block
+        TRYP(res, hard(element_parser(parser, new_node)));
 
-        nodes->len--;
-
-        close_indent(parser);
+        TRYP(res, maybe(soft(accept(parser, ';'))));
+        if (res == TOK_NO_TOK) {
+            TRYP(res, accept(parser, '}'));
+            break;
+        }
     }
 
     res = TOK_ANY;
@@ -303,14 +297,14 @@ int module(parser_t *parser, ast_t *node) {
     int res;
     ast_module_t *module = &node->module;
     module->modid = NULL;
-    TRY(res, vector_init_with_allocator(&module->exports, sizeof(ast_export_t),
-                                        parser->allocator));
+    TRY(res, smallvec_init_with_allocator(
+                 &module->exports, sizeof(ast_export_t), parser->allocator));
 
     TRYP(res, maybe(soft(accept(parser, TOK_MODULE))));
 
     if (res != TOK_NO_TOK) {
         TRYP(res, accept(parser, TOK_CONID));
-        module->modid = parser_get_text(parser);
+        module->modid = parser_get_symbol(parser);
 
         TRYP(res, maybe(exports(parser, &module->exports)));
 
@@ -324,7 +318,7 @@ int module(parser_t *parser, ast_t *node) {
     return res;
 }
 
-int exports(parser_t *parser, vector_t /*ast_export_t*/ *exports) {
+int exports(parser_t *parser, smallvec_t /*ast_export_t*/ *exports) {
     assert(parser != NULL);
     assert(exports != NULL);
 
@@ -333,13 +327,14 @@ int exports(parser_t *parser, vector_t /*ast_export_t*/ *exports) {
     TRYP(res, soft(accept(parser, '(')));
 
     TRYP(res,
-         maybe(export(parser, (ast_export_t *)vector_alloc_elem(exports))));
+         maybe(export(parser, (ast_export_t *)smallvec_alloc_elem(exports))));
     while ((res != TOK_NO_TOK)) {
         TRYP(res, maybe(soft(accept(parser, ','))));
         if (res == TOK_NO_TOK) {
             break;
         }
-        TRYP(res, export(parser, (ast_export_t *)vector_alloc_elem(exports)));
+        TRYP(res,
+             export(parser, (ast_export_t *)smallvec_alloc_elem(exports)));
     }
 
     TRYP(res, accept(parser, ')'));
@@ -354,7 +349,7 @@ int export(parser_t *parser, ast_export_t *ex) {
     int res;
 
     TRYP(res, accept(parser, TOK_VARID));
-    ex->exportid = parser_get_text(parser);
+    ex->exportid = parser_get_symbol(parser);
 
     return res;
 }
@@ -383,7 +378,7 @@ int declaration(parser_t *parser, ast_t *node) {
 
     TRYP(res, soft(accept(parser, TOK_VARID)));
 
-    char *decl_name = parser_get_text(parser);
+    const symbol_t *decl_name = parser_get_symbol(parser);
 
     TRYP(res, hard(function(parser, decl_name, node) ||
                    value(parser, decl_name, node) ||
@@ -392,7 +387,7 @@ int declaration(parser_t *parser, ast_t *node) {
     return res;
 }
 
-int function(parser_t *parser, char *decl_name, ast_t *node) {
+int function(parser_t *parser, const symbol_t *decl_name, ast_t *node) {
     assert(parser != NULL);
     assert(decl_name != NULL);
     assert(node != NULL);
@@ -404,12 +399,13 @@ int function(parser_t *parser, char *decl_name, ast_t *node) {
     ast_fn_decl_t *fn_decl = &node->fn_decl;
 
     fn_decl->name = decl_name;
-    TRY(res, vector_init_with_allocator(&fn_decl->vars, sizeof(char *),
-                                        parser->allocator));
+    TRY(res, smallvec_init_with_allocator(&fn_decl->vars,
+                                          sizeof(const symbol_t *),
+                                          parser->allocator));
 
     do {
-        char *var_name = parser_get_text(parser);
-        vector_push_back(&fn_decl->vars, &var_name);
+        const symbol_t *var_name = parser_get_symbol(parser);
+        smallvec_push_back(&fn_decl->vars, &var_name);
         TRY(res, maybe(soft(accept(parser, TOK_VARID))));
     } while (res != TOK_NO_TOK);
 
@@ -438,7 +434,7 @@ int function(parser_t *parser, char *decl_name, ast_t *node) {
     return res;
 }
 
-int value(parser_t *parser, char *decl_name, ast_t *node) {
+int value(parser_t *parser, const symbol_t *decl_name, ast_t *node) {
     assert(parser != NULL);
     assert(decl_name != NULL);
     assert(node != NULL);
@@ -456,8 +452,6 @@ int value(parser_t *parser, char *decl_name, ast_t *node) {
 
     TRYP(res, maybe(soft(accept(parser, TOK_WHERE))));
     if (res != TOK_NO_TOK) {
-        open_indent(parser);
-
         ast_t *body;
         TRYCR(body, (ast_t *)ALLOC(sizeof(ast_t)), 0, -1);
         memcpy(body, val_decl->body, sizeof(ast_t));
@@ -469,8 +463,6 @@ int value(parser_t *parser, char *decl_name, ast_t *node) {
 
         TRYP(res, bindings(parser, &let->bindings));
 
-        close_indent(parser);
-
         val_decl->body->rule = AST_LET;
     }
 
@@ -478,7 +470,7 @@ int value(parser_t *parser, char *decl_name, ast_t *node) {
     return res;
 }
 
-int has_type(parser_t *parser, char *decl_name, ast_t *node) {
+int has_type(parser_t *parser, const symbol_t *decl_name, ast_t *node) {
     assert(parser != NULL);
     assert(decl_name != NULL);
     assert(node != NULL);
@@ -527,7 +519,7 @@ int expression(parser_t *parser, ast_t *node) {
 
         ast_op_appl_t *op_appl = &node->op_appl;
 
-        op_appl->op_name = parser_get_text(parser);
+        op_appl->op_name = parser_get_symbol(parser);
         op_appl->lhs = lhs;
         TRYCR(op_appl->rhs, (ast_t *)ALLOC(sizeof(ast_t)), NULL, -1);
         TRYP(res, expression(parser, op_appl->rhs));
@@ -667,6 +659,8 @@ int fexpression(parser_t *parser, ast_t *node) {
 
     TRYP(res, soft(aexpression(parser, node)));
 
+    parser_mark_t mark = parser_mark(parser);
+
     ast_t *rhs;
     TRYCR(rhs, (ast_t *)ALLOC(sizeof(ast_t)), NULL, -1);
 
@@ -681,12 +675,15 @@ int fexpression(parser_t *parser, ast_t *node) {
         fn_appl->arg = rhs;
 
         node->rule = AST_FN_APPL;
+
+        mark = parser_mark(parser);
         TRYCR(rhs, (ast_t *)ALLOC(sizeof(ast_t)), NULL, -1);
 
         TRYP(res, maybe(aexpression(parser, rhs)));
     }
 
     FREE(rhs);
+    parser_rewind(parser, mark);
 
     return res;
 }
@@ -700,12 +697,8 @@ int aexpression(parser_t *parser, ast_t *node) {
     TRYP(res, maybe(soft(accept(parser, '('))));
 
     if (res != TOK_NO_TOK) {
-        no_indent(parser);
-
         TRYP(res, expression(parser, node));
         TRYP(res, accept(parser, ')'));
-
-        close_indent(parser);
     } else {
         TRYP(res, var(parser, node) || con(parser, node) || lit(parser, node));
     }
@@ -720,7 +713,7 @@ int var(parser_t *parser, ast_t *node) {
     int res;
 
     TRYP(res, soft(accept(parser, TOK_VARID)));
-    node->var.name = parser_get_text(parser);
+    node->var.name = parser_get_symbol(parser);
 
     node->rule = AST_VAR;
     return res;
@@ -735,13 +728,13 @@ int con(parser_t *parser, ast_t *node) {
     TRYP(res, maybe(soft(accept(parser, TOK_UNIT))));
 
     if (res != TOK_NO_TOK) {
-        node->con.name = STRALLOC("()");
+        node->con.name = parser_get_symbol(parser);
         node->rule = AST_CON;
         return res;
     }
 
     TRYP(res, soft(accept(parser, TOK_CONID)));
-    node->con.name = parser_get_text(parser);
+    node->con.name = parser_get_symbol(parser);
 
     node->rule = AST_CON;
     return res;
@@ -762,13 +755,11 @@ int number(parser_t *parser, ast_t *node) {
     int res;
 
     TRYP(res, soft(accept(parser, TOK_NUMBER)));
-    char *number_str = parser_get_text(parser);
+    const symbol_t *number_str = parser_get_symbol(parser);
 
     ast_lit_t *lit = &node->lit;
     lit->lit_type = AST_LIT_TYPE_INT;
-    lit->int_lit = atoi(number_str);
-
-    FREE(number_str);
+    lit->int_lit = atoi(number_str->str);
 
     node->rule = AST_LIT;
     return res;
@@ -778,11 +769,9 @@ int string(parser_t *parser, ast_t *node) {
     int res;
 
     TRYP(res, soft(accept(parser, TOK_STRING)));
-    char *str = parser_get_text(parser);
-
     ast_lit_t *lit = &node->lit;
     lit->lit_type = AST_LIT_TYPE_STR;
-    lit->str_lit = str;
+    lit->str_lit = parser_get_symbol(parser);
 
     node->rule = AST_LIT;
     return res;
@@ -3,26 +3,27 @@
 
 #include "ast.h"
 #include "data/allocator.h"
-#include "data/stack.h"
+#include "data/linalloc.h"
 #include "lexer.h"
-
-typedef enum {
-    PARSER_NONE = 0,
-    PARSER_NEW_INDENT_ACCEPTED = 1,
-    PARSER_CONTINUE_INDENT = 2,
-} parser_flags_t;
+#include "token_stream.h"
 
 typedef struct parser_ {
-    token_t token;
-    char *ptext;
-    parser_flags_t flags;
-    stack_t /*int*/ indent_stack;
+    const token_stream_t *tokens;
+    size_t cursor; // Index of the current token
+    size_t last;   // Index of the last accepted token
+    const symbol_t *psym; // Its text, once interned
     allocator_t *allocator;
+    linalloc_t *arena; // Backing allocator, if it is a linalloc
 } parser_t;
 
 int parser_init(parser_t *parser);
 void parser_destroy(parser_t *parser);
 
-int parser_parse(parser_t *parser, ast_t *root, allocator_t *allocator);
+void parser_set_arena(parser_t *parser, linalloc_t *arena);
+int parser_parse(parser_t *parser, const token_stream_t *tokens, ast_t *root,
+                 allocator_t *allocator);
+
+token_t parser_peek(const parser_t *parser, size_t k);
+void parser_location(const parser_t *parser, int *line, int *column);
 
 #endif /*SCHC_PARSER_H_*/
\ No newline at end of file
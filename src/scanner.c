@@ -0,0 +1,610 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "scanner.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__) && !defined(SCANNER_NO_SIMD)
+#include <immintrin.h>
+
+// AVX2 code is only compiled for functions marked with this, scanner_init
+// checks the CPU before they get called
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#endif /*__SSE2__ && !SCANNER_NO_SIMD*/
+
+// Runs are only skipped with vectors once they are longer than this
+#define SCANNER_SHORT_RUN 8
+
+// Character classes, a character can be in several
+#define SC_SPACE 0x01 // [ \t]
+#define SC_ID 0x02    // [A-Za-z0-9']
+#define SC_DIGIT 0x04 // [0-9]
+#define SC_OP 0x08    // [!#$%&*+./<=>?@\\^|-]
+
+static const uint8_t scanner_class[256] = {
+    [' '] = SC_SPACE,
+    ['\t'] = SC_SPACE,
+    ['a' ... 'z'] = SC_ID,
+    ['A' ... 'Z'] = SC_ID,
+    ['0' ... '9'] = SC_ID | SC_DIGIT,
+    ['\''] = SC_ID,
+    ['!'] = SC_OP,
+    ['#'] = SC_OP,
+    ['$'] = SC_OP,
+    ['%'] = SC_OP,
+    ['&'] = SC_OP,
+    ['*'] = SC_OP,
+    ['+'] = SC_OP,
+    ['.'] = SC_OP,
+    ['/'] = SC_OP,
+    ['<'] = SC_OP,
+    ['='] = SC_OP,
+    ['>'] = SC_OP,
+    ['?'] = SC_OP,
+    ['@'] = SC_OP,
+    ['\\'] = SC_OP,
+    ['^'] = SC_OP,
+    ['|'] = SC_OP,
+    ['-'] = SC_OP,
+};
+
+static inline size_t scanner_skip_class(const scanner_t *scanner, size_t pos,
+                                        uint8_t cls);
+size_t scanner_skip_long_run(const scanner_t *scanner, size_t pos,
+                             uint8_t cls);
+size_t scanner_skip_class_scalar(const scanner_t *scanner, size_t pos,
+                                 uint8_t cls);
+size_t scanner_block_comment(scanner_t *scanner, size_t pos);
+size_t scanner_block_comment_scalar(scanner_t *scanner, size_t pos);
+token_t scanner_keyword(const char *str, size_t len);
+token_t scanner_op(const char *str, size_t len);
+
+#if defined(__SSE2__) && !defined(SCANNER_NO_SIMD)
+size_t scanner_skip_class_sse2(const scanner_t *scanner, size_t pos,
+                               uint8_t cls);
+size_t scanner_block_comment_sse2(scanner_t *scanner, size_t pos);
+TARGET_AVX2 size_t scanner_skip_class_avx2(const scanner_t *scanner,
+                                            size_t pos, uint8_t cls);
+TARGET_AVX2 size_t scanner_block_comment_avx2(scanner_t *scanner, size_t pos);
+#endif /*__SSE2__ && !SCANNER_NO_SIMD*/
+
+int source_open(source_t *source, const char *path) {
+    assert(source != NULL);
+    assert(path != NULL);
+
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    source->len = st.st_size;
+    source->mapped = source->len > 0;
+    source->mem = "";
+
+    if (source->mapped) {
+        void *mem = mmap(NULL, source->len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mem == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+
+        // Only a hint, scanning works the same without it
+        posix_madvise(mem, source->len, POSIX_MADV_SEQUENTIAL);
+        source->mem = mem;
+    }
+
+    // The mapping stays valid after closing
+    close(fd);
+
+    return 0;
+}
+
+// Scans len bytes of str, which must outlive the source
+void source_init_str(source_t *source, const char *str, size_t len) {
+    assert(source != NULL);
+    assert(str != NULL);
+
+    source->mem = str;
+    source->len = len;
+    source->mapped = 0;
+}
+
+void source_close(source_t *source) {
+    assert(source != NULL);
+
+    if (source->mapped) {
+        munmap((void *)source->mem, source->len);
+        source->mapped = 0;
+    }
+}
+
+void scanner_init(scanner_t *scanner, const source_t *source) {
+    assert(scanner != NULL);
+    assert(source != NULL);
+    assert(source->len <= UINT32_MAX);
+
+    scanner->mem = source->mem;
+    scanner->len = source->len;
+    scanner->pos = 0;
+    scanner->line_start = 0;
+    scanner->line = 1;
+    scanner->tok_line = 1;
+    scanner->tok_column = 0;
+    scanner->simd = SCANNER_SCALAR;
+
+#if defined(__SSE2__) && !defined(SCANNER_NO_SIMD)
+    scanner->simd =
+        __builtin_cpu_supports("avx2") ? SCANNER_AVX2 : SCANNER_SSE2;
+#endif /*__SSE2__ && !SCANNER_NO_SIMD*/
+}
+
+// Returns the kind of the next token and sets token to it, or returns 0 at
+// the end of the source. Characters no rule matches come out as one
+// character TOK_ERROR tokens.
+token_t scanner_next(scanner_t *scanner, scanner_token_t *token) {
+    assert(scanner != NULL);
+    assert(token != NULL);
+
+    const char *mem = scanner->mem;
+    size_t len = scanner->len;
+    size_t pos = scanner->pos;
+    token_t kind;
+
+    for (;;) {
+        if (pos >= len) {
+            scanner->pos = pos;
+            scanner->tok_line = scanner->line;
+            scanner->tok_column = pos - scanner->line_start;
+
+            token->kind = 0;
+            token->offset = pos;
+            token->len = 0;
+
+            return 0;
+        }
+
+        char c = mem[pos];
+        char next = pos + 1 < len ? mem[pos + 1] : '\0';
+
+        if (scanner_class[(uint8_t)c] & SC_SPACE) {
+            pos = scanner_skip_class(scanner, pos + 1, SC_SPACE);
+            continue;
+        }
+
+        if (c == '\n' || (c == '\r' && next == '\n')) {
+            pos += 1 + (next == (c == '\n' ? '\r' : '\n'));
+            scanner->line++;
+            scanner->line_start = pos;
+            continue;
+        }
+
+        if (c == '-' && next == '-') {
+            const char *eol = memchr(mem + pos, '\n', len - pos);
+
+            pos = eol != NULL ? (size_t)(eol - mem) : len;
+            continue;
+        }
+
+        if (c == '{' && next == '-') {
+            pos = scanner_block_comment(scanner, pos + 2);
+            continue;
+        }
+
+        break;
+    }
+
+    size_t start = pos;
+    int line = scanner->line;
+    char c = mem[pos];
+    char next = pos + 1 < len ? mem[pos + 1] : '\0';
+    uint8_t cls = scanner_class[(uint8_t)c];
+
+    if (c >= 'a' && c <= 'z') {
+        pos = scanner_skip_class(scanner, pos + 1, SC_ID);
+        kind = scanner_keyword(mem + start, pos - start);
+    } else if (c >= 'A' && c <= 'Z') {
+        pos = scanner_skip_class(scanner, pos + 1, SC_ID);
+        kind = TOK_CONID;
+    } else if (cls & SC_DIGIT) {
+        pos = scanner_skip_class(scanner, pos + 1, SC_DIGIT);
+        kind = TOK_NUMBER;
+    } else if (cls & SC_OP) {
+        pos = scanner_skip_class(scanner, pos + 1, SC_OP);
+        kind = scanner_op(mem + start, pos - start);
+    } else if (c == '"') {
+        const char *end = memchr(mem + pos + 1, '"', len - pos - 1);
+
+        if (end != NULL) {
+            pos = end - mem + 1;
+            kind = TOK_STRING;
+
+            for (size_t i = start + 1; i < pos; ++i) {
+                scanner->line += mem[i] == '\n';
+            }
+        } else {
+            pos++;
+            kind = TOK_ERROR;
+        }
+    } else if (c == '(' && next == ')') {
+        pos += 2;
+        kind = TOK_UNIT;
+    } else if (c == ':' && next == ':') {
+        pos += 2;
+        kind = TOK_OP_HASTYPE;
+    } else {
+        pos++;
+
+        switch (c) {
+        case '(':
+        case ')':
+        case ',':
+        case ';':
+        case '[':
+        case ']':
+        case '`':
+        case '{':
+        case '}':
+        case '_':
+        case '~':
+        case ':':
+            kind = c;
+            break;
+        default:
+            kind = TOK_ERROR;
+        }
+    }
+
+    scanner->pos = pos;
+    scanner->tok_line = line;
+    scanner->tok_column = start - scanner->line_start;
+
+    token->kind = kind;
+    token->offset = start;
+    token->len = pos - start;
+
+    return kind;
+}
+
+// Returns the end of the run of cls characters starting at pos
+static inline size_t scanner_skip_class(const scanner_t *scanner, size_t pos,
+                                        uint8_t cls) {
+    size_t end = pos + SCANNER_SHORT_RUN < scanner->len
+                     ? pos + SCANNER_SHORT_RUN
+                     : scanner->len;
+
+    // Most runs end within a few characters, too soon to win anything by
+    // loading a vector
+    while (pos < end && (scanner_class[(uint8_t)scanner->mem[pos]] & cls)) {
+        pos++;
+    }
+
+    if (pos < end || pos == scanner->len) {
+        return pos;
+    }
+
+    return scanner_skip_long_run(scanner, pos, cls);
+}
+
+// Kept out of scanner_skip_class so that stays small enough to inline
+size_t scanner_skip_long_run(const scanner_t *scanner, size_t pos,
+                             uint8_t cls) {
+#if defined(__SSE2__) && !defined(SCANNER_NO_SIMD)
+    // Operators are short and their characters have no ranges to compare
+    if (cls != SC_OP) {
+        switch (scanner->simd) {
+        case SCANNER_AVX2:
+            return scanner_skip_class_avx2(scanner, pos, cls);
+        case SCANNER_SSE2:
+            return scanner_skip_class_sse2(scanner, pos, cls);
+        case SCANNER_SCALAR:
+            break;
+        }
+    }
+#endif /*__SSE2__ && !SCANNER_NO_SIMD*/
+
+    return scanner_skip_class_scalar(scanner, pos, cls);
+}
+
+size_t scanner_skip_class_scalar(const scanner_t *scanner, size_t pos,
+                                 uint8_t cls) {
+    while (pos < scanner->len && (scanner_class[(uint8_t)scanner->mem[pos]] &
+                                  cls)) {
+        pos++;
+    }
+
+    return pos;
+}
+
+// Skips to after the "-}" closing a comment whose "{-" ends before pos, or
+// to the end if there is none. Comments do not nest.
+size_t scanner_block_comment(scanner_t *scanner, size_t pos) {
+#if defined(__SSE2__) && !defined(SCANNER_NO_SIMD)
+    switch (scanner->simd) {
+    case SCANNER_AVX2:
+        return scanner_block_comment_avx2(scanner, pos);
+    case SCANNER_SSE2:
+        return scanner_block_comment_sse2(scanner, pos);
+    case SCANNER_SCALAR:
+        break;
+    }
+#endif /*__SSE2__ && !SCANNER_NO_SIMD*/
+
+    return scanner_block_comment_scalar(scanner, pos);
+}
+
+size_t scanner_block_comment_scalar(scanner_t *scanner, size_t pos) {
+    const char *mem = scanner->mem;
+    size_t len = scanner->len;
+
+    for (; pos < len; ++pos) {
+        if (mem[pos] == '\n') {
+            scanner->line++;
+        } else if (mem[pos] == '-' && pos + 1 < len && mem[pos + 1] == '}') {
+            return pos + 2;
+        }
+    }
+
+    return len;
+}
+
+#if defined(__SSE2__) && !defined(SCANNER_NO_SIMD)
+
+// Vector fast paths
+//
+// Runs are matched a vector at a time: every byte is classified at once and
+// the first one outside the class ends the run. Block comments only need
+// their newlines counted and every '-' checked for a '}' after it. Whatever
+// is left at the end of the source, less than a vector, goes through the
+// scalar code.
+
+// Bytes of v in [lo, hi], compared unsigned so bytes over 0x7f are outside
+static inline __m128i sse2_in_range(__m128i v, char lo, char hi) {
+    __m128i x = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(hi - lo)), x);
+}
+
+// Same as scanner_class, but for 16 bytes. Setting 0x20 folds upper case
+// letters into lower case and moves nothing else into [a-z].
+static inline uint32_t sse2_class_mask(__m128i v, uint8_t cls) {
+    __m128i mask;
+
+    if (cls == SC_SPACE) {
+        mask = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                            _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    } else {
+        mask = sse2_in_range(v, '0', '9');
+
+        if (cls == SC_ID) {
+            __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+
+            mask = _mm_or_si128(mask, sse2_in_range(folded, 'a', 'z'));
+            mask = _mm_or_si128(mask, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+        }
+    }
+
+    return _mm_movemask_epi8(mask);
+}
+
+size_t scanner_skip_class_sse2(const scanner_t *scanner, size_t pos,
+                               uint8_t cls) {
+    for (; pos + 16 <= scanner->len; pos += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(scanner->mem + pos));
+        uint32_t outside = ~sse2_class_mask(v, cls) & 0xffff;
+
+        if (outside != 0) {
+            return pos + __builtin_ctz(outside);
+        }
+    }
+
+    return scanner_skip_class_scalar(scanner, pos, cls);
+}
+
+size_t scanner_block_comment_sse2(scanner_t *scanner, size_t pos) {
+    const char *mem = scanner->mem;
+    size_t len = scanner->len;
+
+    while (pos + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(mem + pos));
+        uint32_t dashes =
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')));
+        uint32_t newlines =
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+
+        if (dashes == 0) {
+            scanner->line += __builtin_popcount(newlines);
+            pos += 16;
+            continue;
+        }
+
+        // Stop at the first '-', the next vector starts right after it
+        int dash = __builtin_ctz(dashes);
+
+        scanner->line += __builtin_popcount(newlines & ((1u << dash) - 1));
+        pos += dash;
+
+        if (pos + 1 < len && mem[pos + 1] == '}') {
+            return pos + 2;
+        }
+
+        pos++;
+    }
+
+    return scanner_block_comment_scalar(scanner, pos);
+}
+
+TARGET_AVX2 static inline __m256i avx2_in_range(__m256i v, char lo, char hi) {
+    __m256i x = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(hi - lo)), x);
+}
+
+TARGET_AVX2 static inline uint32_t avx2_class_mask(__m256i v, uint8_t cls) {
+    __m256i mask;
+
+    if (cls == SC_SPACE) {
+        mask = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                               _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    } else {
+        mask = avx2_in_range(v, '0', '9');
+
+        if (cls == SC_ID) {
+            __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+            mask = _mm256_or_si256(mask, avx2_in_range(folded, 'a', 'z'));
+            mask = _mm256_or_si256(
+                mask, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+        }
+    }
+
+    return _mm256_movemask_epi8(mask);
+}
+
+TARGET_AVX2 size_t scanner_skip_class_avx2(const scanner_t *scanner,
+                                            size_t pos, uint8_t cls) {
+    for (; pos + 32 <= scanner->len; pos += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(scanner->mem + pos));
+        uint32_t outside = ~avx2_class_mask(v, cls);
+
+        if (outside != 0) {
+            return pos + __builtin_ctz(outside);
+        }
+    }
+
+    return scanner_skip_class_sse2(scanner, pos, cls);
+}
+
+TARGET_AVX2 size_t scanner_block_comment_avx2(scanner_t *scanner,
+                                               size_t pos) {
+    const char *mem = scanner->mem;
+    size_t len = scanner->len;
+
+    while (pos + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(mem + pos));
+        uint32_t dashes =
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')));
+        uint32_t newlines =
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+
+        if (dashes == 0) {
+            scanner->line += __builtin_popcount(newlines);
+            pos += 32;
+            continue;
+        }
+
+        int dash = __builtin_ctz(dashes);
+
+        scanner->line += __builtin_popcount(newlines & ((1u << dash) - 1));
+        pos += dash;
+
+        if (pos + 1 < len && mem[pos + 1] == '}') {
+            return pos + 2;
+        }
+
+        pos++;
+    }
+
+    return scanner_block_comment_sse2(scanner, pos);
+}
+
+#endif /*__SSE2__ && !SCANNER_NO_SIMD*/
+
+// A whole identifier is matched before keywords, so "letter" stays a VARID
+token_t scanner_keyword(const char *str, size_t len) {
+#define KEYWORD(kw, tok)                                                       \
+    if (len == sizeof(kw) - 1 && !memcmp(str, kw, len)) {                      \
+        return tok;                                                            \
+    }
+
+    switch (str[0]) {
+    case 'c':
+        KEYWORD("case", TOK_CASE);
+        KEYWORD("class", TOK_CLASS);
+        break;
+    case 'd':
+        KEYWORD("data", TOK_DATA);
+        KEYWORD("default", TOK_DEFAULT);
+        KEYWORD("deriving", TOK_DERIVING);
+        KEYWORD("do", TOK_DO);
+        break;
+    case 'e':
+        KEYWORD("else", TOK_ELSE);
+        break;
+    case 'f':
+        KEYWORD("foreign", TOK_FOREIGN);
+        break;
+    case 'i':
+        KEYWORD("if", TOK_IF);
+        KEYWORD("import", TOK_IMPORT);
+        KEYWORD("in", TOK_IN);
+        KEYWORD("infix", TOK_INFIX);
+        KEYWORD("infixl", TOK_INFIXL);
+        KEYWORD("infixr", TOK_INFIXR);
+        KEYWORD("instance", TOK_INSTANCE);
+        break;
+    case 'l':
+        KEYWORD("let", TOK_LET);
+        break;
+    case 'm':
+        KEYWORD("module", TOK_MODULE);
+        break;
+    case 'n':
+        KEYWORD("newtype", TOK_NEWTYPE);
+        break;
+    case 'o':
+        KEYWORD("of", TOK_OF);
+        break;
+    case 't':
+        KEYWORD("then", TOK_THEN);
+        KEYWORD("type", TOK_TYPE);
+        break;
+    case 'w':
+        KEYWORD("where", TOK_WHERE);
+        break;
+    }
+
+#undef KEYWORD
+
+    return TOK_VARID;
+}
+
+// Operator characters are matched as a whole run first too. Only runs that
+// are exactly one of the reserved operators get their own token.
+token_t scanner_op(const char *str, size_t len) {
+    if (len == 1) {
+        switch (str[0]) {
+        case '.':
+        case '-':
+        case '=':
+        case '\\':
+        case '|':
+        case '@':
+            return str[0];
+        }
+    } else if (len == 2) {
+        if (!memcmp(str, "..", 2)) {
+            return TOK_OP_RANGE;
+        } else if (!memcmp(str, "<-", 2)) {
+            return TOK_OP_L_ARROW;
+        } else if (!memcmp(str, "->", 2)) {
+            return TOK_OP_R_ARROW;
+        } else if (!memcmp(str, "=>", 2)) {
+            return TOK_OP_R_FAT_ARROW;
+        }
+    }
+
+    return TOK_OP;
+}
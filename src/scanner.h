@@ -0,0 +1,54 @@
+#ifndef SCHC_SCANNER_H_
+#define SCHC_SCANNER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lexer.h"
+
+// Source text to scan. Files are memory mapped read-only, so tokens can point
+// straight into them for as long as the source stays open.
+typedef struct source_ {
+    const char *mem;
+    size_t len;
+    int mapped;
+} source_t;
+
+int source_open(source_t *source, const char *path);
+void source_init_str(source_t *source, const char *str, size_t len);
+void source_close(source_t *source);
+
+// A token is a slice of the source, nothing is copied
+typedef struct scanner_token_ {
+    token_t kind;
+    uint32_t offset;
+    uint32_t len;
+} scanner_token_t;
+
+// Fast paths for skipping runs of spaces, identifier characters and block
+// comments, from narrowest to widest. They all give the same tokens.
+typedef enum scanner_simd_ {
+    SCANNER_SCALAR,
+    SCANNER_SSE2,
+    SCANNER_AVX2,
+} scanner_simd_t;
+
+// Hand-written lexer over a source_t, an alternative to the flex one in
+// gen_lexer.l that produces the same tokens. Lines and columns are also
+// counted like there: columns start over only on newlines outside of
+// comments and strings.
+typedef struct scanner_ {
+    const char *mem;
+    size_t len;
+    size_t pos;
+    size_t line_start; // Offset columns are counted from
+    int line;
+    int tok_line; // Position of the last token
+    int tok_column;
+    scanner_simd_t simd; // Widest one the CPU runs, may be lowered after init
+} scanner_t;
+
+void scanner_init(scanner_t *scanner, const source_t *source);
+token_t scanner_next(scanner_t *scanner, scanner_token_t *token);
+
+#endif /*SCHC_SCANNER_H_*/
@@ -1,60 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ast.h"
 #include "core.h"
 #include "coregen.h"
+#include "data/allocstats.h"
 #include "data/hashmap.h"
 #include "data/linalloc.h"
+#include "data/pool.h"
+#include "data/symtab.h"
 #include "intrinsics/intrinsics.h"
 #include "lexer.h"
 #include "parser.h"
+#include "scanner.h"
+#include "token_stream.h"
 
 void usage();
+void mem_report_print(const alloc_stats_t *parser_stats,
+                      const alloc_stats_t *core_stats);
+void expr_format(void *elem, size_t index, void *arg);
+
+typedef struct expr_dumps_ {
+    core_expr_t **exprs;
+    char **texts;
+} expr_dumps_t;
 
 int main(int argc, char *argv[]) {
     puts("Simple C Haskell Compiler");
 
-    if (argc < 2) {
+    const char *input_filename = NULL;
+    int mem_report = 0;
+    size_t jobs = 0; // As many as CPUs
+    int use_scanner = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--mem-report")) {
+            mem_report = 1;
+        } else if ((!strcmp(argv[i], "-j") || !strcmp(argv[i], "--jobs")) &&
+                   i + 1 < argc) {
+            jobs = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--lexer") && i + 1 < argc) {
+            use_scanner = !strcmp(argv[++i], "mmap");
+        } else {
+            input_filename = argv[i];
+        }
+    }
+
+    if (input_filename == NULL) {
         usage(argv[0]);
         return 1;
     }
 
-    const char *input_filename = argv[1];
+    // The scanner maps the file instead of reading it through stdio
+    FILE *input = NULL;
+    source_t source;
 
-    FILE *input = fopen(input_filename, "r");
-    if (input == NULL) {
+    if (use_scanner ? source_open(&source, input_filename) == -1
+                    : (input = fopen(input_filename, "r")) == NULL) {
         fprintf(stderr, "Could not open file '%s': ", input_filename);
         perror("");
         return 1;
     }
 
-    yyin = input;
-    yyout = stdout;
+    // The whole file is lexed before parsing
+    token_stream_t tokens;
+    token_stream_init(&tokens, &default_allocator);
+
+    if (use_scanner) {
+        token_stream_scan(&tokens, &source);
+    } else {
+        lexer_t lexer;
 
-    // int token;
-    // while((token = yylex()) != 0) {
-    //   printf("%-20s %s\n", strtoken(token), yytext);
-    // }
+        if (lexer_init(&lexer, input) == -1) {
+            fprintf(stderr, "Could not start lexing '%s'\n", input_filename);
+            return 1;
+        }
+
+        token_stream_flex(&tokens, &lexer);
+        lexer_destroy(&lexer);
+    }
+
+    // Indentation becomes braces and semicolons before the parser sees it
+    token_stream_layout(&tokens);
 
     allocator_t parser_allocator;
     linalloc_t parser_linalloc;
     linalloc_init(&parser_linalloc);
     linalloc_allocator(&parser_linalloc, &parser_allocator);
 
+    // With --mem-report allocations go through a counting allocator
+    allocator_t parser_linalloc_allocator = parser_allocator;
+    alloc_stats_t parser_stats;
+    alloc_stats_init(&parser_stats, "parser", &parser_linalloc_allocator);
+    if (mem_report) {
+        alloc_stats_allocator(&parser_stats, &parser_allocator);
+    }
+    alloc_stats_phase(&parser_stats, "parse");
+
     parser_t parser;
     parser_init(&parser);
+    parser_set_arena(&parser, &parser_linalloc);
 
     ast_t ast;
 
-    if (parser_parse(&parser, &ast, &parser_allocator) == -1) {
-        fprintf(stderr, "Parse error(%d, %d): %s unexpected\n", yylineno,
-                yycolumn, strtoken(parser.token));
-        fclose(input);
+    if (parser_parse(&parser, &tokens, &ast, &parser_allocator) == -1) {
+        int line, column;
+        parser_location(&parser, &line, &column);
+
+        fprintf(stderr, "Parse error(%d, %d): %s unexpected\n", line, column,
+                strtoken(parser_peek(&parser, 0)));
         return 1;
     }
 
-    yylex_destroy();
+    // Parsed symbols are interned copies, the source is not needed anymore
+    token_stream_destroy(&tokens);
+    if (use_scanner) {
+        source_close(&source);
+    }
     parser_destroy(&parser);
 
     puts("AST:");
@@ -68,49 +134,113 @@ int main(int argc, char *argv[]) {
     linalloc_init(&linalloc);
     linalloc_allocator(&linalloc, &core_allocator);
 
-    env_t env, intrinsics_env;
-    env_init_with_allocator(&env, &core_allocator);
-    env_init_with_allocator(&intrinsics_env, &core_allocator);
+    allocator_t core_linalloc_allocator = core_allocator;
+    alloc_stats_t core_stats;
+    alloc_stats_init(&core_stats, "core", &core_linalloc_allocator);
+    if (mem_report) {
+        alloc_stats_allocator(&core_stats, &core_allocator);
+    }
+    alloc_stats_phase(&core_stats, "intrinsics");
 
+    env_t env, intrinsics_env;
+    env_init_persistent(&intrinsics_env, &core_allocator);
     intrinsics_load(&intrinsics_env);
-    env.upper_scope = &intrinsics_env;
+
+    env_init_scope(&env, &intrinsics_env);
+
+    alloc_stats_phase(&core_stats, "coregen");
 
     if (coregen_from_module_ast(&ast, &env) == -1) {
         fprintf(stderr, "Coregen error\n");
-        fclose(input);
         return 1;
     }
 
+    alloc_stats_phase(&parser_stats, "destroy");
     ast_destroy(&ast, &parser_allocator);
-    linalloc_destroy(&parser_linalloc);
 
     puts("EXPRs:");
     puts("========================================");
 
-    const vector_t /* const char* */ *keys = hashmap_keys(&env.scope);
-
-    for (size_t i = 0; i < keys->len; ++i) {
-        const char *expr_name = *((const char **)vector_get_ref(keys, i));
-        const core_expr_t *expr =
-            *((const core_expr_t **)hashmap_get(&env.scope, expr_name));
-
-        printf("%s => ", expr_name);
-        core_print(expr, stdout);
+    vector_t /* const symbol_t * */ module_scope;
+    vector_init(&module_scope, sizeof(const symbol_t *));
+    env_list_scope(&env, &module_scope, 0);
+
+    // Expressions are formatted in parallel and printed in order
+    pool_t pool;
+    pool_init(&pool, jobs);
+
+    expr_dumps_t dumps = {malloc(module_scope.len * sizeof(core_expr_t *)),
+                          calloc(module_scope.len, sizeof(char *))};
+    env_get_many(&env, vector_get_mem(&module_scope), module_scope.len,
+                 dumps.exprs);
+    pool_parallel_for(&pool, &module_scope, 1, expr_format, &dumps);
+
+    for (size_t i = 0; i < module_scope.len; ++i) {
+        if (dumps.texts[i] != NULL) {
+            fputs(dumps.texts[i], stdout);
+            free(dumps.texts[i]);
+        }
         puts("");
     }
 
+    free(dumps.texts);
+    free(dumps.exprs);
+    pool_destroy(&pool);
+    vector_destroy(&module_scope);
+
     puts("========================================");
     puts("");
 
+    alloc_stats_phase(&core_stats, "destroy");
     env_destroy(&env);
 
+    if (mem_report) {
+        mem_report_print(&parser_stats, &core_stats);
+    }
+
+    linalloc_destroy(&parser_linalloc);
     linalloc_destroy(&linalloc);
 
-    fclose(input);
+    symtab_destroy();
+
+    if (input != NULL) {
+        fclose(input);
+    }
 
     return 0;
 }
 
 void usage(const char *name) {
-    fprintf(stderr, "Usage: %s <input file>\n", name);
+    fprintf(stderr,
+            "Usage: %s [--mem-report] [-j|--jobs N] [--lexer flex|mmap] "
+            "<input file>\n",
+            name);
+}
+
+void expr_format(void *elem, size_t index, void *arg) {
+    const symbol_t *expr_name = *(const symbol_t **)elem;
+    expr_dumps_t *dumps = arg;
+    size_t size;
+
+    FILE *fp = open_memstream(&dumps->texts[index], &size);
+    if (fp == NULL) {
+        return;
+    }
+
+    fprintf(fp, "%s => ", expr_name->str);
+    core_print(dumps->exprs[index], fp);
+    fclose(fp);
+}
+
+void mem_report_print(const alloc_stats_t *parser_stats,
+                      const alloc_stats_t *core_stats) {
+    size_t symbols, symbol_bytes;
+    symtab_usage(&symbols, &symbol_bytes);
+
+    puts("Memory:");
+    puts("========================================");
+    printf("lexer: %zu symbols in %zu bytes\n", symbols, symbol_bytes);
+    alloc_stats_print(parser_stats, stdout);
+    alloc_stats_print(core_stats, stdout);
+    puts("========================================");
 }
\ No newline at end of file
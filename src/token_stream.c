@@ -0,0 +1,468 @@
+#include "token_stream.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "data/vector.h"
+#include "util.h"
+
+#define TOKEN_STREAM_INITIAL_CAP 64
+// Guess of the source bytes per token, to size the arrays once
+#define TOKEN_STREAM_BYTES_PER_TOKEN 4
+
+#define ALLOC(size) ALLOCATOR_ALLOC(tokens->allocator, (size))
+#define REALLOC(ptr, size) ALLOCATOR_REALLOC(tokens->allocator, (ptr), (size))
+#define FREE(mem) ALLOCATOR_FREE(tokens->allocator, (mem))
+
+int token_stream_grow(token_stream_t *tokens, size_t cap);
+int token_stream_push(token_stream_t *tokens, token_t kind, size_t offset,
+                      size_t len, int line, int column);
+int token_stream_copy_text(token_stream_t *tokens, const char *text,
+                           size_t len);
+
+// Layout contexts, see token_stream_layout
+typedef enum layout_kind_ {
+    LAYOUT_IMPLICIT, // A block delimited by indentation
+    LAYOUT_EXPLICIT, // A block delimited by braces
+    LAYOUT_BRACKET,  // '(', '[' or if, for what closes blocks inside them
+} layout_kind_t;
+
+typedef struct layout_context_ {
+    layout_kind_t kind;
+    token_t opener;
+    int column; // Of the first token of an implicit block
+} layout_context_t;
+
+#define LAYOUT_NONE SIZE_MAX
+
+int layout_push(vector_t *contexts, layout_kind_t kind, token_t opener,
+                int column);
+int layout_indent(const vector_t *contexts);
+size_t layout_find(const vector_t *contexts, token_t a, token_t b);
+int layout_virtual(token_stream_t *out, const token_stream_t *tokens,
+                   size_t i, token_t kind);
+int layout_close(token_stream_t *out, const token_stream_t *tokens, size_t i,
+                 vector_t *contexts, size_t depth);
+int layout_line_start(token_stream_t *out, const token_stream_t *tokens,
+                      size_t i, vector_t *contexts);
+int layout_close_before(token_stream_t *out, const token_stream_t *tokens,
+                        size_t i, vector_t *contexts);
+int layout_end_line(const token_stream_t *tokens, size_t i);
+
+int token_stream_init(token_stream_t *tokens, allocator_t *allocator) {
+    assert(tokens != NULL);
+    assert(allocator != NULL);
+
+    tokens->allocator = allocator;
+    tokens->text = "";
+    tokens->owned_text = NULL;
+    tokens->owned_len = 0;
+    tokens->owned_cap = 0;
+    tokens->len = 0;
+    tokens->cap = TOKEN_STREAM_INITIAL_CAP;
+
+    size_t cap = tokens->cap;
+
+    TRYCR(tokens->kinds, ALLOC(cap * sizeof(int16_t)), NULL, -1);
+    TRYCR(tokens->offsets, ALLOC(cap * sizeof(uint32_t)), NULL, -1);
+    TRYCR(tokens->lens, ALLOC(cap * sizeof(uint32_t)), NULL, -1);
+    TRYCR(tokens->lines, ALLOC(cap * sizeof(uint32_t)), NULL, -1);
+    TRYCR(tokens->columns, ALLOC(cap * sizeof(uint32_t)), NULL, -1);
+
+    return 0;
+}
+
+void token_stream_destroy(token_stream_t *tokens) {
+    assert(tokens != NULL);
+
+    FREE(tokens->kinds);
+    FREE(tokens->offsets);
+    FREE(tokens->lens);
+    FREE(tokens->lines);
+    FREE(tokens->columns);
+
+    if (tokens->owned_text != NULL) {
+        FREE(tokens->owned_text);
+    }
+}
+
+// Lexes all of source with the scanner. Tokens point into the source, which
+// must stay open while they are used.
+int token_stream_scan(token_stream_t *tokens, const source_t *source) {
+    assert(tokens != NULL);
+    assert(source != NULL);
+
+    int res;
+    scanner_t scanner;
+    scanner_token_t tok;
+    size_t guess = source->len / TOKEN_STREAM_BYTES_PER_TOKEN + 1;
+
+    if (guess > tokens->cap) {
+        TRY(res, token_stream_grow(tokens, guess));
+    }
+
+    tokens->text = source->mem;
+    scanner_init(&scanner, source);
+
+    do {
+        scanner_next(&scanner, &tok);
+        TRY(res, token_stream_push(tokens, tok.kind, tok.offset, tok.len,
+                                   scanner.tok_line, scanner.tok_column));
+    } while (tok.kind != 0);
+
+    return 0;
+}
+
+// Lexes everything left in lexer. Its text is only valid until the next
+// token, so it is copied into the stream.
+int token_stream_flex(token_stream_t *tokens, lexer_t *lexer) {
+    assert(tokens != NULL);
+    assert(lexer != NULL);
+
+    int res;
+    token_t kind;
+
+    do {
+        kind = lexer_next(lexer);
+
+        const char *text = kind != 0 ? lexer_text(lexer) : "";
+        size_t len = kind != 0 ? lexer_len(lexer) : 0;
+        int line = lexer_line(lexer);
+
+        // The line count is past any newline in the token
+        for (size_t i = 0; i < len; ++i) {
+            line -= text[i] == '\n';
+        }
+
+        TRY(res, token_stream_push(tokens, kind, tokens->owned_len, len, line,
+                                   lexer_column(lexer) - len));
+        TRY(res, token_stream_copy_text(tokens, text, len));
+    } while (kind != 0);
+
+    tokens->text = tokens->owned_text;
+
+    return 0;
+}
+
+// Layout
+//
+// Blocks after where, let, do and of, and the body of a module without a
+// header, can be delimited by indentation instead of braces. This pass
+// resolves that once over the whole stream, following the algorithm of the
+// Haskell report: an implicit block opens at the column of its first token,
+// a line starting at that column gets a ';' before it and one starting left
+// of it closes the block. The braces and semicolons are inserted as zero
+// length tokens at the position of the token they precede, so the parser
+// only ever deals with braces.
+//
+// The report also closes an implicit block wherever the next token would not
+// parse otherwise, which cannot be known before parsing. The cases that come
+// up in practice are approximated instead: "in" closes a let block, closing
+// brackets and commas close the blocks opened inside their bracket and
+// "then" and "else" the ones opened since their "if".
+
+// Replaces the tokens with ones where the layout is explicit
+int token_stream_layout(token_stream_t *tokens) {
+    assert(tokens != NULL);
+    assert(tokens->len > 0 && tokens->kinds[tokens->len - 1] == 0);
+
+    int res;
+    token_stream_t out;
+    vector_t /*layout_context_t*/ contexts;
+
+    TRY(res, token_stream_init(&out, tokens->allocator));
+    TRY(res, token_stream_grow(&out, tokens->len + tokens->len / 4));
+    TRY(res, vector_init_with_allocator(&contexts, sizeof(layout_context_t),
+                                        tokens->allocator));
+
+    // What opens a block at the next token, if anything
+    token_t opener = tokens->kinds[0] != TOK_MODULE ? TOK_MODULE : 0;
+    int prev_line = 0;
+
+    for (size_t i = 0; i < tokens->len; ++i) {
+        int kind = tokens->kinds[i];
+        int column = tokens->columns[i];
+        int line_start = (int)tokens->lines[i] > prev_line && kind != 0;
+
+        if (opener != 0 && kind != '{') {
+            if (kind != 0 && column > layout_indent(&contexts)) {
+                TRY(res, layout_push(&contexts, LAYOUT_IMPLICIT, opener,
+                                     column));
+                TRY(res, layout_virtual(&out, tokens, i, '{'));
+
+                // The block starts on this line, it needs no ';'
+                line_start = 0;
+            } else {
+                TRY(res, layout_virtual(&out, tokens, i, '{'));
+                TRY(res, layout_virtual(&out, tokens, i, '}'));
+            }
+        }
+
+        opener = 0;
+
+        if (line_start) {
+            TRY(res, layout_line_start(&out, tokens, i, &contexts));
+        }
+
+        TRY(res, layout_close_before(&out, tokens, i, &contexts));
+        TRY(res, token_stream_push(&out, kind, tokens->offsets[i],
+                                   tokens->lens[i], tokens->lines[i], column));
+
+        switch (kind) {
+        case TOK_WHERE:
+        case TOK_LET:
+        case TOK_DO:
+        case TOK_OF:
+            opener = kind;
+            break;
+        case '{':
+            TRY(res, layout_push(&contexts, LAYOUT_EXPLICIT, kind, -1));
+            break;
+        case '(':
+        case '[':
+        case TOK_IF:
+            TRY(res, layout_push(&contexts, LAYOUT_BRACKET, kind, -1));
+            break;
+        }
+
+        prev_line = layout_end_line(tokens, i);
+    }
+
+    vector_destroy(&contexts);
+
+    FREE(tokens->kinds);
+    FREE(tokens->offsets);
+    FREE(tokens->lens);
+    FREE(tokens->lines);
+    FREE(tokens->columns);
+
+    tokens->len = out.len;
+    tokens->cap = out.cap;
+    tokens->kinds = out.kinds;
+    tokens->offsets = out.offsets;
+    tokens->lens = out.lens;
+    tokens->lines = out.lines;
+    tokens->columns = out.columns;
+
+    return 0;
+}
+
+int layout_push(vector_t *contexts, layout_kind_t kind, token_t opener,
+                int column) {
+    layout_context_t context = {kind, opener, column};
+    void *elem;
+
+    TRYCR(elem, vector_push_back(contexts, &context), NULL, -1);
+
+    return 0;
+}
+
+// Column a new implicit block has to start right of
+int layout_indent(const vector_t *contexts) {
+    for (size_t i = contexts->len; i-- > 0;) {
+        const layout_context_t *context = vector_get_ref(contexts, i);
+
+        if (context->kind == LAYOUT_IMPLICIT) {
+            return context->column;
+        } else if (context->kind == LAYOUT_EXPLICIT) {
+            return -1;
+        }
+    }
+
+    return -1;
+}
+
+// Index of the innermost bracket or explicit block opened by a or b, looking
+// past implicit blocks and ifs only
+size_t layout_find(const vector_t *contexts, token_t a, token_t b) {
+    for (size_t i = contexts->len; i-- > 0;) {
+        const layout_context_t *context = vector_get_ref(contexts, i);
+
+        if (context->kind != LAYOUT_IMPLICIT &&
+            (context->opener == a || context->opener == b)) {
+            return i;
+        } else if (context->kind != LAYOUT_IMPLICIT &&
+                   context->opener != TOK_IF) {
+            break;
+        }
+    }
+
+    return LAYOUT_NONE;
+}
+
+// Inserts a token of kind before token i
+int layout_virtual(token_stream_t *out, const token_stream_t *tokens,
+                   size_t i, token_t kind) {
+    return token_stream_push(out, kind, tokens->offsets[i], 0,
+                             tokens->lines[i], tokens->columns[i]);
+}
+
+// Pops contexts down to depth, closing the implicit blocks among them
+int layout_close(token_stream_t *out, const token_stream_t *tokens, size_t i,
+                 vector_t *contexts, size_t depth) {
+    int res;
+
+    while (contexts->len > depth) {
+        const layout_context_t *context =
+            vector_get_ref(contexts, contexts->len - 1);
+
+        if (context->kind == LAYOUT_IMPLICIT) {
+            TRY(res, layout_virtual(out, tokens, i, '}'));
+        }
+
+        contexts->len--;
+    }
+
+    return 0;
+}
+
+// Token i is the first on its line, compare it to the enclosing blocks
+int layout_line_start(token_stream_t *out, const token_stream_t *tokens,
+                      size_t i, vector_t *contexts) {
+    int res;
+    int column = tokens->columns[i];
+
+    for (size_t j = contexts->len; j-- > 0;) {
+        const layout_context_t *context = vector_get_ref(contexts, j);
+
+        if (context->kind == LAYOUT_EXPLICIT) {
+            break;
+        } else if (context->kind == LAYOUT_BRACKET) {
+            continue;
+        }
+
+        if (column == context->column) {
+            TRY(res, layout_virtual(out, tokens, i, ';'));
+            break;
+        } else if (column > context->column) {
+            break;
+        }
+
+        TRY(res, layout_close(out, tokens, i, contexts, j));
+    }
+
+    return 0;
+}
+
+// Closes the blocks token i can only come after
+int layout_close_before(token_stream_t *out, const token_stream_t *tokens,
+                        size_t i, vector_t *contexts) {
+    size_t j = LAYOUT_NONE;
+    size_t keep = 1; // Whether the bracket itself stays open
+
+    switch (tokens->kinds[i]) {
+    case 0:
+        return layout_close(out, tokens, i, contexts, 0);
+    case TOK_IN:
+        if (contexts->len > 0) {
+            const layout_context_t *context =
+                vector_get_ref(contexts, contexts->len - 1);
+
+            if (context->kind == LAYOUT_IMPLICIT &&
+                context->opener == TOK_LET) {
+                j = contexts->len - 1;
+                keep = 0;
+            }
+        }
+        break;
+    case ',':
+        j = layout_find(contexts, '(', '[');
+        break;
+    case ')':
+    case ']':
+        j = layout_find(contexts, '(', '[');
+        keep = 0;
+        break;
+    case '}':
+        j = layout_find(contexts, '{', '{');
+        keep = 0;
+        break;
+    case TOK_THEN:
+        j = layout_find(contexts, TOK_IF, TOK_IF);
+        break;
+    case TOK_ELSE:
+        j = layout_find(contexts, TOK_IF, TOK_IF);
+        keep = 0;
+        break;
+    }
+
+    if (j == LAYOUT_NONE) {
+        return 0;
+    }
+
+    return layout_close(out, tokens, i, contexts, j + keep);
+}
+
+// Line token i ends on, strings can span several
+int layout_end_line(const token_stream_t *tokens, size_t i) {
+    int line = tokens->lines[i];
+
+    if (tokens->kinds[i] == TOK_STRING) {
+        const char *text = tokens->text + tokens->offsets[i];
+
+        for (size_t j = 0; j < tokens->lens[i]; ++j) {
+            line += text[j] == '\n';
+        }
+    }
+
+    return line;
+}
+
+int token_stream_grow(token_stream_t *tokens, size_t cap) {
+    TRYCR(tokens->kinds, REALLOC(tokens->kinds, cap * sizeof(int16_t)), NULL,
+          -1);
+    TRYCR(tokens->offsets, REALLOC(tokens->offsets, cap * sizeof(uint32_t)),
+          NULL, -1);
+    TRYCR(tokens->lens, REALLOC(tokens->lens, cap * sizeof(uint32_t)), NULL,
+          -1);
+    TRYCR(tokens->lines, REALLOC(tokens->lines, cap * sizeof(uint32_t)), NULL,
+          -1);
+    TRYCR(tokens->columns, REALLOC(tokens->columns, cap * sizeof(uint32_t)),
+          NULL, -1);
+
+    tokens->cap = cap;
+
+    return 0;
+}
+
+int token_stream_push(token_stream_t *tokens, token_t kind, size_t offset,
+                      size_t len, int line, int column) {
+    int res;
+
+    if (tokens->len == tokens->cap) {
+        TRY(res, token_stream_grow(tokens, tokens->cap * 2));
+    }
+
+    size_t i = tokens->len++;
+
+    tokens->kinds[i] = kind;
+    tokens->offsets[i] = offset;
+    tokens->lens[i] = len;
+    tokens->lines[i] = line;
+    tokens->columns[i] = column;
+
+    return 0;
+}
+
+int token_stream_copy_text(token_stream_t *tokens, const char *text,
+                           size_t len) {
+    size_t cap = tokens->owned_cap > 0 ? tokens->owned_cap : 256;
+
+    while (tokens->owned_len + len + 1 > cap) {
+        cap *= 2;
+    }
+
+    if (tokens->owned_text == NULL) {
+        TRYCR(tokens->owned_text, ALLOC(cap), NULL, -1);
+        tokens->owned_cap = cap;
+    } else if (cap != tokens->owned_cap) {
+        TRYCR(tokens->owned_text, REALLOC(tokens->owned_text, cap), NULL, -1);
+        tokens->owned_cap = cap;
+    }
+
+    memcpy(tokens->owned_text + tokens->owned_len, text, len);
+    tokens->owned_len += len;
+    tokens->owned_text[tokens->owned_len] = '\0';
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef SCHC_TOKEN_STREAM_H_
+#define SCHC_TOKEN_STREAM_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "data/allocator.h"
+#include "lexer.h"
+#include "scanner.h"
+
+// Every token of a file, lexed up front. Each field is its own array so the
+// parser, which mostly looks at kinds, walks them sequentially and can look
+// any number of tokens ahead or go back by moving an index.
+//
+// The last token always has kind 0 and marks the end. Braces and semicolons
+// token_stream_layout inserts have length 0.
+typedef struct token_stream_ {
+    allocator_t *allocator;
+    const char *text; // Token offsets are into this
+    char *owned_text; // Token text copied out of flex, if lexed with it
+    size_t owned_len;
+    size_t owned_cap;
+    size_t len;
+    size_t cap;
+    int16_t *kinds;
+    uint32_t *offsets;
+    uint32_t *lens;
+    uint32_t *lines;
+    uint32_t *columns;
+} token_stream_t;
+
+int token_stream_init(token_stream_t *tokens, allocator_t *allocator);
+void token_stream_destroy(token_stream_t *tokens);
+
+int token_stream_scan(token_stream_t *tokens, const source_t *source);
+int token_stream_flex(token_stream_t *tokens, lexer_t *lexer);
+int token_stream_layout(token_stream_t *tokens);
+
+#endif /*SCHC_TOKEN_STREAM_H_*/
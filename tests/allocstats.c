@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <data/allocstats.h>
+#include <data/vector.h>
+
+#include <test.h>
+
+static char *test_alloc_stats() {
+    alloc_stats_t stats;
+    allocator_t allocator;
+
+    test_assert("Stats initialized",
+                !alloc_stats_init(&stats, "test", &default_allocator));
+    alloc_stats_allocator(&stats, &allocator);
+
+    test_assert("phase(build)", !alloc_stats_phase(&stats, "build"));
+
+    vector_t vector;
+    test_assert("Vector is initialized",
+                !vector_init_with_allocator(&vector, sizeof(int), &allocator));
+
+    for (int i = 0; i < 100; i++) {
+        test_assert("push_back", vector_push_back(&vector, &i) != NULL);
+    }
+
+    char *str = ALLOCATOR_STRALLOC(&allocator, "Hello test!");
+    test_assert("Data goes through", !strcmp(str, "Hello test!"));
+
+    const alloc_phase_stats_t *build = &stats.phases[stats.phase];
+
+    test_assert("2 allocs", build->allocs == 2);
+    test_assert("Vector grew 5 times", build->reallocs == 5);
+    test_assert("Live bytes", stats.live == 128 * sizeof(int) + 12);
+    test_assert("Peak is at least live", stats.peak_live >= stats.live);
+    test_assert("Both allocs are at most 16 bytes", build->histogram[4] == 2);
+
+    test_assert("phase(destroy)", !alloc_stats_phase(&stats, "destroy"));
+
+    vector_destroy(&vector);
+    ALLOCATOR_FREE(&allocator, str);
+
+    test_assert("2 frees", stats.phases[stats.phase].frees == 2);
+    test_assert("Build frees nothing", build->frees == 0);
+    test_assert("Nothing live", stats.live == 0);
+
+    test_assert("Phases are reused", !alloc_stats_phase(&stats, "build") &&
+                                         &stats.phases[stats.phase] == build);
+
+    return NULL;
+}
+
+int main() {
+    test_run(test_alloc_stats);
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <data/chashmap.h>
+#include <data/hashmap.h>
+
+#include <test.h>
+
+#define TEST_KEYS 20000
+#define TEST_THREADS 4
+
+static const symbol_t *keys[TEST_KEYS];
+static int values[TEST_THREADS][TEST_KEYS];
+
+static void init_keys() {
+    for (int i = 0; i < TEST_KEYS; i++) {
+        char key[24];
+
+        sprintf(key, (i % 2) ? "c%d" : "someLongerName%d", i);
+        keys[i] = symtab_intern(key);
+
+        for (int t = 0; t < TEST_THREADS; t++) {
+            values[t][i] = i;
+        }
+    }
+}
+
+static char *test_chashmap() {
+    chashmap_t map;
+
+    test_assert("Chashmap is initialized", !chashmap_init(&map, 0));
+    test_assert("get(c1) == NULL", chashmap_get_sym(&map, keys[1]) == NULL);
+
+    for (int i = 0; i < TEST_KEYS; i++) {
+        test_assert("put(#, #)",
+                    !chashmap_put_sym(&map, keys[i], &values[0][i]));
+    }
+
+    for (int i = 0; i < TEST_KEYS; i++) {
+        test_assert("get(#) == #",
+                    chashmap_get_sym(&map, keys[i]) == &values[0][i]);
+    }
+
+    test_assert("put(c1, other)",
+                !chashmap_put_sym(&map, keys[1], &values[1][1]));
+    test_assert("get(c1) == other",
+                chashmap_get_sym(&map, keys[1]) == &values[1][1]);
+    test_assert("get(missing) == NULL",
+                chashmap_get_sym(&map, symtab_intern("missing")) == NULL);
+    test_assert("Map grew", map.first->next != NULL);
+
+    chashmap_destroy(&map);
+
+    return NULL;
+}
+
+typedef struct worker_ {
+    chashmap_t *map;
+    int thread;
+    int failed;
+} worker_t;
+
+// Every thread puts every key, each starting at a different offset, and
+// checks that its own puts are visible right after
+static void *put_worker(void *data) {
+    worker_t *worker = data;
+
+    for (int n = 0; n < TEST_KEYS; n++) {
+        int i = (n + worker->thread * TEST_KEYS / TEST_THREADS) % TEST_KEYS;
+
+        if (chashmap_put_sym(worker->map, keys[i],
+                             &values[worker->thread][i]) ||
+            chashmap_get_sym(worker->map, keys[i]) == NULL) {
+            worker->failed = 1;
+        }
+    }
+
+    return NULL;
+}
+
+static char *test_chashmap_concurrent() {
+    chashmap_t map;
+    pthread_t threads[TEST_THREADS];
+    worker_t workers[TEST_THREADS];
+
+    test_assert("Chashmap is initialized", !chashmap_init(&map, 0));
+
+    for (int t = 0; t < TEST_THREADS; t++) {
+        workers[t] = (worker_t){.map = &map, .thread = t, .failed = 0};
+
+        test_assert("Thread started", !pthread_create(&threads[t], NULL,
+                                                      put_worker, &workers[t]));
+    }
+
+    for (int t = 0; t < TEST_THREADS; t++) {
+        test_assert("Thread joined", !pthread_join(threads[t], NULL));
+        test_assert("Thread saw its puts", !workers[t].failed);
+    }
+
+    // Whoever put last wins, but the value has to be one of theirs
+    for (int i = 0; i < TEST_KEYS; i++) {
+        const int *value = chashmap_get_sym(&map, keys[i]);
+
+        test_assert("get(#) != NULL", value != NULL);
+        test_assert("get(#) == #", *value == i);
+    }
+
+    chashmap_destroy(&map);
+
+    return NULL;
+}
+
+// Lookup heavy benchmark, shaped like coregen resolving names against the
+// module and intrinsics envs: mostly hits, a few misses and a few puts
+
+#define BENCH_OPS 2000000
+#define BENCH_MAX_THREADS 8
+#define BENCH_PUT_EVERY 64
+#define BENCH_MISS_EVERY 8
+
+typedef struct bench_worker_ {
+    chashmap_t *chashmap;
+    hashmap_t *hashmap;
+    pthread_rwlock_t *lock;
+    int thread;
+    long hits;
+} bench_worker_t;
+
+static const symbol_t *bench_missing[TEST_KEYS / BENCH_MISS_EVERY];
+
+static void *bench_chashmap_worker(void *data) {
+    bench_worker_t *worker = data;
+    unsigned i = worker->thread * 7919;
+
+    for (int n = 0; n < BENCH_OPS; n++, i = i * 1103515245 + 12345) {
+        size_t k = (i >> 8) % TEST_KEYS;
+
+        if (n % BENCH_PUT_EVERY == 0) {
+            chashmap_put_sym(worker->chashmap, keys[k],
+                             &values[worker->thread % TEST_THREADS][k]);
+        } else if (n % BENCH_MISS_EVERY == 0) {
+            worker->hits += chashmap_get_sym(
+                                worker->chashmap,
+                                bench_missing[k / BENCH_MISS_EVERY]) != NULL;
+        } else {
+            worker->hits += chashmap_get_sym(worker->chashmap, keys[k]) != NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static void *bench_rwlock_worker(void *data) {
+    bench_worker_t *worker = data;
+    unsigned i = worker->thread * 7919;
+
+    for (int n = 0; n < BENCH_OPS; n++, i = i * 1103515245 + 12345) {
+        size_t k = (i >> 8) % TEST_KEYS;
+        const int *value = &values[worker->thread % TEST_THREADS][k];
+
+        if (n % BENCH_PUT_EVERY == 0) {
+            pthread_rwlock_wrlock(worker->lock);
+            hashmap_put_sym(worker->hashmap, keys[k], &value);
+            pthread_rwlock_unlock(worker->lock);
+        } else {
+            const symbol_t *key = n % BENCH_MISS_EVERY == 0
+                                      ? bench_missing[k / BENCH_MISS_EVERY]
+                                      : keys[k];
+
+            pthread_rwlock_rdlock(worker->lock);
+            worker->hits += hashmap_get_sym(worker->hashmap, key) != NULL;
+            pthread_rwlock_unlock(worker->lock);
+        }
+    }
+
+    return NULL;
+}
+
+static double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char *bench_run(const char *name, void *(*fn)(void *),
+                       bench_worker_t *proto, int nthreads) {
+    pthread_t threads[BENCH_MAX_THREADS];
+    bench_worker_t workers[BENCH_MAX_THREADS];
+
+    double start = bench_now();
+
+    for (int t = 0; t < nthreads; t++) {
+        workers[t] = *proto;
+        workers[t].thread = t;
+        workers[t].hits = 0;
+
+        test_assert("Thread started",
+                    !pthread_create(&threads[t], NULL, fn, &workers[t]));
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+        test_assert("Thread joined", !pthread_join(threads[t], NULL));
+        test_assert("Lookups hit", workers[t].hits > 0);
+    }
+
+    double elapsed = bench_now() - start;
+
+    fprintf(stderr, "%-8s %d threads: %6.1f Mops/s\n", name, nthreads,
+            (double)nthreads * BENCH_OPS / elapsed / 1e6);
+
+    return NULL;
+}
+
+static char *bench_chashmap() {
+    char *res;
+    chashmap_t chashmap;
+    hashmap_t hashmap;
+    pthread_rwlock_t lock;
+
+    for (int i = 0; i < TEST_KEYS / BENCH_MISS_EVERY; i++) {
+        char key[24];
+
+        sprintf(key, "missing%d", i);
+        bench_missing[i] = symtab_intern(key);
+    }
+
+    test_assert("Chashmap is initialized", !chashmap_init(&chashmap, 0));
+    test_assert("Hashmap is initialized",
+                !hashmap_init(&hashmap, sizeof(const int *)));
+    test_assert("Lock is initialized", !pthread_rwlock_init(&lock, NULL));
+
+    for (int i = 0; i < TEST_KEYS; i++) {
+        const int *value = &values[0][i];
+
+        test_assert("put(#, #)",
+                    !chashmap_put_sym(&chashmap, keys[i], &values[0][i]));
+        test_assert("put(#, #)", !hashmap_put_sym(&hashmap, keys[i], &value));
+    }
+
+    bench_worker_t proto = {
+        .chashmap = &chashmap, .hashmap = &hashmap, .lock = &lock};
+
+    for (int nthreads = 1; nthreads <= BENCH_MAX_THREADS; nthreads *= 2) {
+        if ((res = bench_run("chashmap", bench_chashmap_worker, &proto,
+                             nthreads)) ||
+            (res = bench_run("rwlock", bench_rwlock_worker, &proto,
+                             nthreads))) {
+            return res;
+        }
+    }
+
+    pthread_rwlock_destroy(&lock);
+    hashmap_destroy(&hashmap);
+    chashmap_destroy(&chashmap);
+
+    return NULL;
+}
+
+int main() {
+    init_keys();
+
+    test_run(test_chashmap);
+    test_run(test_chashmap_concurrent);
+    test_run(bench_chashmap);
+
+    symtab_destroy();
+
+    return 0;
+}
@@ -1,59 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <ast.h>
 #include <env.h>
 #include <lexer.h>
 #include <parser.h>
+#include <token_stream.h>
 
 #include <core.h>
 #include <coregen.h>
+#include <data/slab.h>
 #include <intrinsics/intrinsics.h>
 
+#include <test.h>
 #include <util.h>
 
-typedef size_t yy_size_t;
-typedef struct yy_buffer_state *YY_BUFFER_STATE;
-extern YY_BUFFER_STATE yy_scan_string(char *str);
-
 char PROGRAM[] = "              \n\
 main = putStrLn (show (f 3))    \n\
                                 \n\
 f x = x * 2                     \n\
                                 \n\
+g x = let { x = 1; y = x + 2 }  \n\
+      in y * x                  \n\
                                 \n\
 ";
 
-int main() {
+// Prints expr into a string of its own, NULL if that failed
+static char *core_print_str(const core_expr_t *expr) {
+    FILE *fp = tmpfile();
+    char *text = NULL;
+    long size;
+
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    if (core_print(expr, fp) != -1 && (size = ftell(fp)) != -1 &&
+        (text = malloc(size + 1)) != NULL) {
+        rewind(fp);
+        text[fread(text, 1, size, fp)] = '\0';
+    }
+
+    fclose(fp);
+
+    return text;
+}
+
+// Generates core for PROGRAM, printing every module var, and returns the
+// printed core of g or NULL if anything failed
+static char *compile_program(allocator_t *parser_allocator,
+                             allocator_t *core_allocator) {
     parser_t parser;
+    lexer_t lexer;
+    char *g_text = NULL;
 
-    yy_scan_string(PROGRAM);
+    lexer_init_str(&lexer, PROGRAM);
     parser_init(&parser);
 
-    allocator_t parser_allocator;
-    parser_allocator = default_allocator;
-    /*
-    linalloc_t parser_linalloc;
-    linalloc_init(&parser_linalloc);
-    linalloc_allocator(&parser_linalloc, &parser_allocator);
-    */
+    token_stream_t tokens;
+    token_stream_init(&tokens, &default_allocator);
+    token_stream_flex(&tokens, &lexer);
+    lexer_destroy(&lexer);
+    token_stream_layout(&tokens);
 
     ast_t ast;
-    parser_parse(&parser, &ast, &parser_allocator);
+    if (parser_parse(&parser, &tokens, &ast, parser_allocator) == -1) {
+        parser_destroy(&parser);
+        token_stream_destroy(&tokens);
+        return NULL;
+    }
 
     ast_print(&ast, stdout);
 
-    yylex_destroy();
-
-    allocator_t core_allocator;
-    core_allocator = default_allocator;
-    /*
-    linalloc_t linalloc;
-    linalloc_init(&linalloc);
-    linalloc_allocator(&linalloc, &core_allocator);
-    */
+    token_stream_destroy(&tokens);
 
     env_t env, intrinsics_env;
-    env_init_with_allocator(&env, &core_allocator);
-    env_init_with_allocator(&intrinsics_env, &core_allocator);
+    env_init_with_allocator(&env, core_allocator);
+    env_init_with_allocator(&intrinsics_env, core_allocator);
 
     intrinsics_load(&intrinsics_env);
     env.upper_scope = &intrinsics_env;
@@ -62,25 +86,89 @@ int main() {
 
     parser_destroy(&parser);
 
-    vector_t /* const char * */ module_scope;
-    vector_init(&module_scope, sizeof(const char *));
+    vector_t /* const symbol_t * */ module_scope;
+    vector_init(&module_scope, sizeof(const symbol_t *));
 
     env_list_scope(&env, &module_scope, 0);
 
     for (size_t i = 0; i < module_scope.len; ++i) {
-        const char *varname = *(const char **)vector_get_ref(&module_scope, i);
+        const symbol_t *varname =
+            *(const symbol_t **)vector_get_ref(&module_scope, i);
 
         const core_expr_t *expr = env_get_expr(&env, varname);
 
-        printf("var %s\n", varname);
+        printf("var %s\n", varname->str);
         core_print(expr, stdout);
+
+        if (!strcmp(varname->str, "g")) {
+            g_text = core_print_str(expr);
+        }
     }
 
     env_destroy(&env);
-    ast_destroy(&ast, &parser_allocator);
+    ast_destroy(&ast, parser_allocator);
     vector_destroy(&module_scope);
-    // linalloc_destroy(&parser_linalloc);
-    // linalloc_destroy(&linalloc);
+
+    return g_text;
+}
+
+// The let body still refers to its bindings after their scope is popped,
+// y as x + 2 and x as 1
+static char *check_let_bindings(const char *g_text) {
+    test_assert("g is generated", g_text != NULL);
+    test_assert("g uses y and x", !strcmp(g_text, "g := LAMBDA {\n"
+                                                  "  arg = <arg> : TODO\n"
+                                                  "  body = APPL {\n"
+                                                  "    fn = APPL {\n"
+                                                  "      fn = * := #mult\n"
+                                                  "      arg = APPL {\n"
+                                                  "        fn = APPL {\n"
+                                                  "          fn = + := #plus\n"
+                                                  "          arg = 1i64\n"
+                                                  "        }\n"
+                                                  "        arg = 2i64\n"
+                                                  "      }\n"
+                                                  "    }\n"
+                                                  "    arg = 1i64\n"
+                                                  "  }\n"
+                                                  "}\n"));
+
+    return NULL;
+}
+
+static char *test_slab_pools() {
+    allocator_t parser_allocator, core_allocator;
+    slab_pool_t parser_pool, core_pool;
+
+    slab_pool_init(&parser_pool);
+    slab_pool_allocator(&parser_pool, &parser_allocator);
+    slab_pool_init(&core_pool);
+    slab_pool_allocator(&core_pool, &core_allocator);
+
+    char *g_text = compile_program(&parser_allocator, &core_allocator);
+    char *message = check_let_bindings(g_text);
+
+    free(g_text);
+    slab_pool_destroy(&core_pool);
+    slab_pool_destroy(&parser_pool);
+
+    return message;
+}
+
+// Every node is a malloc of its own here, so a sanitizer sees any node that
+// is used after being freed
+static char *test_default_allocator() {
+    char *g_text = compile_program(&default_allocator, &default_allocator);
+    char *message = check_let_bindings(g_text);
+
+    free(g_text);
+
+    return message;
+}
+
+int main() {
+    test_run(test_slab_pools);
+    test_run(test_default_allocator);
 
     return 0;
 }
@@ -1,6 +1,14 @@
 
+#define _POSIX_C_SOURCE 199309L
+
+#include <inttypes.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
+#include <data/hamt.h>
+#include <data/hash.h>
 #include <data/hashmap.h>
 #include <data/linalloc.h>
 
@@ -8,6 +16,33 @@
 
 allocator_t *allocator;
 
+static char *test_hash_bytes() {
+    const char *str = "someIdentifier'";
+    char buf[65];
+
+    test_assert("hash_str(s) == hash_bytes(s, strlen(s))",
+                hash_str(str) == hash_bytes(str, strlen(str)));
+    test_assert("hash(foo) != hash(bar)", hash_str("foo") != hash_str("bar"));
+    test_assert("hash(x) != hash(x')", hash_str("x") != hash_str("x'"));
+
+    memset(buf, 'a', sizeof(buf));
+
+    // Every prefix length goes through a different read path
+    for (size_t len = 0; len < sizeof(buf); len++) {
+        uint64_t h = hash_bytes(buf, len);
+
+        for (size_t other = 0; other < len; other++) {
+            test_assert("Prefixes hash differently",
+                        h != hash_bytes(buf, other));
+        }
+
+        test_assert("hash_bytes only reads len bytes",
+                    h == hash_bytes(buf, len));
+    }
+
+    return NULL;
+}
+
 static char *test_hashmap_init_with_cap() {
     hashmap_t map;
 
@@ -82,19 +117,698 @@ static char *test_hashmap_growth() {
     test_assert("get(foo) == null", hashmap_get(&map, "foo") == NULL);
 
     test_assert("map has 1500 length", map.len == 1500);
-    test_assert("map has 4096 capacity", map.cap == 4096);
+    test_assert("map has 2048 capacity", map.cap == 2048);
 
     hashmap_destroy(&map);
 
     return NULL;
 }
 
+static char *test_hashmap_small() {
+    hashmap_t map;
+
+    test_assert("Hashmap is initialized",
+                !hashmap_init_with_cap_and_allocator(&map, sizeof(int), 0,
+                                                     allocator));
+    test_assert("Hashmap starts small", map.ctrl == NULL);
+
+    for (int i = 0; i < HASHMAP_SMALL_CAP; i++) {
+        char key[10];
+
+        sprintf(key, "s%d", i);
+
+        test_assert("put(s#, #)", !hashmap_put(&map, key, &i));
+    }
+
+    int i12 = 12;
+
+    test_assert("put(s3, 12)", !hashmap_put(&map, "s3", &i12));
+    test_assert("Replacing does not grow", map.ctrl == NULL);
+    test_assert("get(s3) == 12", *((int *)hashmap_get(&map, "s3")) == 12);
+    test_assert("get(foo) == null", hashmap_get(&map, "foo") == NULL);
+
+    int i42 = 42;
+
+    test_assert("put(someLongerName, 42)",
+                !hashmap_put(&map, "someLongerName", &i42));
+    test_assert("Hashmap became a hash table", map.ctrl != NULL);
+    test_assert("map has SMALL_CAP + 1 length",
+                map.len == HASHMAP_SMALL_CAP + 1);
+
+    test_assert("get(s0) == 0", *((int *)hashmap_get(&map, "s0")) == 0);
+    test_assert("get(s3) == 12", *((int *)hashmap_get(&map, "s3")) == 12);
+    test_assert("get(someLongerName) == 42",
+                *((int *)hashmap_get(&map, "someLongerName")) == 42);
+    test_assert("get(foo) == null", hashmap_get(&map, "foo") == NULL);
+
+    hashmap_destroy(&map);
+
+    return NULL;
+}
+
+static char *test_hashmap_incremental() {
+    hashmap_t map;
+    const symbol_t *syms[5000];
+
+    test_assert("Hashmap is initialized",
+                !hashmap_init_with_cap_and_allocator(&map, sizeof(int), 0,
+                                                     allocator));
+    hashmap_set_incremental(&map, 1);
+
+    int migrating = 0;
+
+    for (int i = 0; i < 5000; i++) {
+        char key[10];
+
+        sprintf(key, "i%d", i);
+        syms[i] = symtab_intern(key);
+
+        test_assert("put(i#, #)", !hashmap_put_sym(&map, syms[i], &i));
+        migrating |= map.old.ctrl != NULL;
+
+        // Replacing a key that may still be in the previous table
+        int twice = i * 2;
+        test_assert("put(i#/2, #)",
+                    !hashmap_put_sym(&map, syms[i / 2], &twice));
+
+        test_assert("get(i#) by symbol",
+                    hashmap_get_sym(&map, syms[i / 3]) != NULL);
+        test_assert("get(i#) by string", hashmap_get(&map, key) != NULL);
+    }
+
+    test_assert("Grew incrementally", migrating);
+    test_assert("map has 5000 keys", map.len == 5000);
+    test_assert("keys has 5000 keys", hashmap_keys(&map)->len == 5000);
+
+    for (int i = 0; i < 5000; i++) {
+        int expected = i <= 4999 / 2 ? i * 4 + 2 : i;
+        int *value = hashmap_get_sym(&map, syms[i]);
+
+        test_assert("get(i#) == #", value != NULL && *value == expected);
+    }
+
+    test_assert("get(foo) == null", hashmap_get(&map, "foo") == NULL);
+
+    hashmap_set_incremental(&map, 0);
+    test_assert("Turning it off finishes the migration",
+                map.old.ctrl == NULL);
+    test_assert("get(i4999) == 4999",
+                *(int *)hashmap_get_sym(&map, syms[4999]) == 4999);
+
+    hashmap_destroy(&map);
+
+    return NULL;
+}
+
+static char *test_hashmap_get_many() {
+    hashmap_t map;
+    const symbol_t *syms[100];
+    void *out[100];
+    int values[100];
+
+    test_assert("Hashmap is initialized",
+                !hashmap_init_with_cap_and_allocator(&map, sizeof(int), 0,
+                                                     allocator));
+
+    for (int i = 0; i < 100; i++) {
+        char key[10];
+
+        sprintf(key, "m%d", i);
+        syms[i] = symtab_intern(key);
+        values[i] = i;
+    }
+
+    // Small map, then a table with every other key missing
+    for (int i = 0; i < 4; i++) {
+        test_assert("put(m#, #)", !hashmap_put_sym(&map, syms[i], &i));
+    }
+
+    hashmap_get_many(&map, syms, 6, out);
+    test_assert("get_many(m3) == 3", *(int *)out[3] == 3);
+    test_assert("get_many(m5) == NULL", out[5] == NULL);
+
+    for (int i = 0; i < 100; i += 2) {
+        test_assert("put(m#, #)", !hashmap_put_sym(&map, syms[i], &values[i]));
+    }
+
+    hashmap_get_many(&map, syms, 100, out);
+
+    for (int i = 0; i < 100; i++) {
+        test_assert("get_many(m#) == get(m#)",
+                    out[i] == hashmap_get_sym(&map, syms[i]));
+        test_assert("Only put keys are found",
+                    (out[i] != NULL) == (i % 2 == 0 || i < 4));
+    }
+
+    hashmap_destroy(&map);
+
+    return NULL;
+}
+
+static char *test_hashmap_remove() {
+    hashmap_t map;
+    const symbol_t *syms[5000];
+
+    for (int i = 0; i < 5000; i++) {
+        char key[10];
+
+        sprintf(key, "r%d", i);
+        syms[i] = symtab_intern(key);
+    }
+
+    // Small maps stay packed
+    test_assert("Hashmap is initialized",
+                !hashmap_init_with_cap_and_allocator(&map, sizeof(int), 0,
+                                                     allocator));
+
+    for (int i = 0; i < 6; i++) {
+        test_assert("put(r#, #)", !hashmap_put_sym(&map, syms[i], &i));
+    }
+
+    int out = -1;
+
+    test_assert("remove(r2)", !hashmap_remove_sym(&map, syms[2], &out));
+    test_assert("Removed value is 2", out == 2);
+    test_assert("remove(r2) again fails",
+                hashmap_remove_sym(&map, syms[2], NULL) == -1);
+    test_assert("remove(r5) by string", !hashmap_remove(&map, "r5", NULL));
+    test_assert("map has 4 keys", map.len == 4);
+    test_assert("keys has 4 keys", hashmap_keys(&map)->len == 4);
+    test_assert("get(r2) == null", hashmap_get_sym(&map, syms[2]) == NULL);
+    test_assert("get(r4) == 4", *(int *)hashmap_get_sym(&map, syms[4]) == 4);
+
+    hashmap_destroy(&map);
+
+    // A table near its maximum load has long runs, some wrapping around
+    test_assert("Hashmap is initialized",
+                !hashmap_init_with_cap_and_allocator(&map, sizeof(int), 256,
+                                                     allocator));
+
+    for (int i = 0; i < 220; i++) {
+        test_assert("put(r#, #)", !hashmap_put_sym(&map, syms[i], &i));
+    }
+
+    test_assert("Did not grow", map.cap == 256);
+
+    for (int i = 0; i < 220; i += 3) {
+        test_assert("remove(r#)", !hashmap_remove_sym(&map, syms[i], NULL));
+    }
+
+    for (int i = 0; i < 220; i++) {
+        int *value = hashmap_get_sym(&map, syms[i]);
+
+        test_assert("get(r#) after removals",
+                    i % 3 == 0 ? value == NULL : value != NULL && *value == i);
+    }
+
+    for (int i = 0; i < 220; i++) {
+        if (i % 3 != 0) {
+            test_assert("remove(r#)", !hashmap_remove_sym(&map, syms[i], NULL));
+        }
+    }
+
+    size_t empty = 0;
+    for (size_t i = 0; i < map.cap; i++) {
+        empty += map.ctrl[i] == 0x80;
+    }
+
+    test_assert("map is empty", map.len == 0 && hashmap_keys(&map)->len == 0);
+    test_assert("No slot is left used", empty == map.cap);
+
+    hashmap_destroy(&map);
+
+    // Keys may still be in the previous table while growing incrementally
+    test_assert("Hashmap is initialized",
+                !hashmap_init_with_cap_and_allocator(&map, sizeof(int), 0,
+                                                     allocator));
+    hashmap_set_incremental(&map, 1);
+
+    int removed_old = 0;
+
+    for (int i = 0; i < 5000; i++) {
+        test_assert("put(r#, #)", !hashmap_put_sym(&map, syms[i], &i));
+
+        if (i % 2 == 1) {
+            removed_old |= map.old.ctrl != NULL &&
+                           hashmap_get_sym(&map, syms[i / 2]) != NULL;
+            test_assert("remove(r#/2)",
+                        !hashmap_remove_sym(&map, syms[i / 2], NULL));
+        }
+    }
+
+    test_assert("Removed while growing", removed_old);
+    test_assert("map has 2500 keys", map.len == 2500);
+
+    hashmap_set_incremental(&map, 0);
+
+    for (int i = 0; i < 5000; i++) {
+        int *value = hashmap_get_sym(&map, syms[i]);
+
+        test_assert("get(r#) after removals",
+                    i < 2500 ? value == NULL : value != NULL && *value == i);
+    }
+
+    // Clearing keeps the table for reuse
+    size_t cap = map.cap;
+
+    hashmap_clear(&map);
+    test_assert("map is empty", map.len == 0 && hashmap_keys(&map)->len == 0);
+    test_assert("Capacity is kept", map.cap == cap);
+    test_assert("get(r4999) == null",
+                hashmap_get_sym(&map, syms[4999]) == NULL);
+
+    for (int i = 0; i < 100; i++) {
+        test_assert("put(r#, #)", !hashmap_put_sym(&map, syms[i], &i));
+    }
+
+    test_assert("map has 100 keys", map.len == 100);
+    test_assert("get(r99) == 99",
+                *(int *)hashmap_get_sym(&map, syms[99]) == 99);
+
+    hashmap_destroy(&map);
+
+    return NULL;
+}
+
+static char *test_hamt_share() {
+    hamt_t base, child;
+    const symbol_t *syms[1000];
+    int values[1000];
+
+    test_assert("Hamt is initialized",
+                !hamt_init_with_allocator(&base, allocator));
+
+    for (int i = 0; i < 1000; i++) {
+        char key[10];
+
+        sprintf(key, "h%d", i);
+        syms[i] = symtab_intern(key);
+        values[i] = i;
+
+        test_assert("put(h#, #)", !hamt_put_sym(&base, syms[i], &values[i]));
+    }
+
+    test_assert("get(h0) == 0", *(int *)hamt_get_sym(&base, syms[0]) == 0);
+    test_assert("get(h999) == 999",
+                *(int *)hamt_get_sym(&base, syms[999]) == 999);
+    test_assert("get(foo) == null",
+                hamt_get_sym(&base, symtab_intern("foo")) == NULL);
+
+    test_assert("Hamt is initialized",
+                !hamt_init_with_allocator(&child, allocator));
+    hamt_share(&child, &base);
+
+    int i42 = 42;
+
+    test_assert("put(child, h7, 42)", !hamt_put_sym(&child, syms[7], &i42));
+    test_assert("put(child, h7, 42) again",
+                !hamt_put_sym(&child, syms[7], &i42));
+    test_assert("put(child, foo, 42)",
+                !hamt_put_sym(&child, symtab_intern("foo"), &i42));
+
+    test_assert("get(child, h7) == 42",
+                *(int *)hamt_get_sym(&child, syms[7]) == 42);
+    test_assert("get(child, h8) == 8",
+                *(int *)hamt_get_sym(&child, syms[8]) == 8);
+    test_assert("Child only lists its own keys", hamt_keys(&child)->len == 2);
+
+    test_assert("get(base, h7) == 7",
+                *(int *)hamt_get_sym(&base, syms[7]) == 7);
+    test_assert("get(base, foo) == null",
+                hamt_get_sym(&base, symtab_intern("foo")) == NULL);
+    test_assert("Base still is at the shared root", child.shared == base.root);
+
+    const symbol_t *many[] = {syms[7], syms[8], symtab_intern("foo"),
+                              symtab_intern("missing")};
+    void *out[4];
+
+    hamt_get_many(&child, many, 4, out);
+    test_assert("get_many(h7) == 42", out[0] == &i42);
+    test_assert("get_many(h8) == 8", out[1] == &values[8]);
+    test_assert("get_many(foo) == 42", out[2] == &i42);
+    test_assert("get_many(missing) == NULL", out[3] == NULL);
+
+    hamt_mark_t mark = hamt_mark(&child);
+
+    test_assert("put(child, h9, 42)", !hamt_put_sym(&child, syms[9], &i42));
+    test_assert("put(child, bar, 42)",
+                !hamt_put_sym(&child, symtab_intern("bar"), &i42));
+
+    hamt_rewind(&child, mark);
+    test_assert("get(child, h9) == 9 after rewind",
+                *(int *)hamt_get_sym(&child, syms[9]) == 9);
+    test_assert("get(child, bar) == null after rewind",
+                hamt_get_sym(&child, symtab_intern("bar")) == NULL);
+    test_assert("get(child, h7) == 42 after rewind",
+                *(int *)hamt_get_sym(&child, syms[7]) == 42);
+    test_assert("Rewound keys", hamt_keys(&child)->len == 2);
+
+    hamt_destroy(&child);
+    hamt_destroy(&base);
+
+    return NULL;
+}
+
+static char *test_hamt_collisions() {
+    hamt_t hamt;
+    symbol_t *a = malloc(sizeof(symbol_t));
+    symbol_t *b = malloc(sizeof(symbol_t));
+    symbol_t *c = malloc(sizeof(symbol_t));
+    int ia = 1, ib = 2, ic = 3;
+
+    // Same full hash, and a hash that only differs in the last level
+    a->hash = b->hash = 0x0123456789abcdefULL;
+    c->hash = a->hash ^ (1ULL << 63);
+
+    test_assert("Hamt is initialized",
+                !hamt_init_with_allocator(&hamt, allocator));
+    test_assert("put(a, 1)", !hamt_put_sym(&hamt, a, &ia));
+    test_assert("put(b, 2)", !hamt_put_sym(&hamt, b, &ib));
+    test_assert("put(c, 3)", !hamt_put_sym(&hamt, c, &ic));
+
+    test_assert("get(a) == 1", hamt_get_sym(&hamt, a) == &ia);
+    test_assert("get(b) == 2", hamt_get_sym(&hamt, b) == &ib);
+    test_assert("get(c) == 3", hamt_get_sym(&hamt, c) == &ic);
+
+    test_assert("put(a, 3)", !hamt_put_sym(&hamt, a, &ic));
+    test_assert("get(a) == 3", hamt_get_sym(&hamt, a) == &ic);
+    test_assert("get(b) == 2", hamt_get_sym(&hamt, b) == &ib);
+    test_assert("Hamt has 3 keys", hamt_keys(&hamt)->len == 3);
+
+    hamt_destroy(&hamt);
+    free(a);
+    free(b);
+    free(c);
+
+    return NULL;
+}
+
+#define BENCH_KEYS 100000
+#define BENCH_ROUNDS 10
+
+static char bench_keys[BENCH_KEYS][24];
+static size_t bench_lens[BENCH_KEYS];
+
+static double bench_ns(clock_t start, clock_t end, size_t ops) {
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / ops;
+}
+
+// (1 - 1/buckets)^keys, the expected fraction of empty buckets
+static double pow_ratio(int keys, int buckets) {
+    double res = 1.0;
+
+    for (int i = 0; i < keys; i++) {
+        res *= 1.0 - 1.0 / buckets;
+    }
+
+    return res;
+}
+
+static void bench_init_keys() {
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        sprintf(bench_keys[i], (i % 2) ? "x%d" : "someLongerName%d", i);
+        bench_lens[i] = strlen(bench_keys[i]);
+    }
+}
+
+static char *bench_hashmap_put_get() {
+    hashmap_t map;
+
+    test_assert("Hashmap is initialized",
+                !hashmap_init_with_cap_and_allocator(&map, sizeof(int), 256,
+                                                     allocator));
+
+    clock_t start = clock();
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        test_assert("put(key, #)", !hashmap_put(&map, bench_keys[i], &i));
+    }
+    clock_t put_end = clock();
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int i = 0; i < BENCH_KEYS; i++) {
+            test_assert("get(key) != null",
+                        hashmap_get(&map, bench_keys[i]) != NULL);
+        }
+    }
+    clock_t hit_end = clock();
+
+    char missing[32];
+    int misses = 0;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int i = 0; i < BENCH_KEYS; i++) {
+            sprintf(missing, "y%d", i);
+            misses += hashmap_get(&map, missing) == NULL;
+        }
+    }
+    clock_t miss_end = clock();
+
+    test_assert("No false hits", misses == BENCH_KEYS * BENCH_ROUNDS);
+
+    fprintf(stderr,
+            "hashmap %d keys: put %.1f ns/op, get hit %.1f ns/op, "
+            "get miss %.1f ns/op (cap %zu)\n",
+            BENCH_KEYS, bench_ns(start, put_end, BENCH_KEYS),
+            bench_ns(put_end, hit_end, BENCH_KEYS * BENCH_ROUNDS),
+            bench_ns(hit_end, miss_end, BENCH_KEYS * BENCH_ROUNDS), map.cap);
+
+    hashmap_destroy(&map);
+
+    return NULL;
+}
+
+// Previous hashmap hash, kept for comparison. Includes the fibonacci
+// multiplication hashmap_t used to spread it with.
+static uint64_t legacy_hash(const char *str) {
+    uint64_t res = 0;
+    const char *ptr = str;
+    uint64_t buf = 0;
+
+    while (*ptr != '\0') {
+        // strncpy(&buf, ptr, 8) without the truncation warning
+        buf = 0;
+        for (int i = 0; i < sizeof(uint64_t) && *ptr != '\0'; ++i, ++ptr) {
+            ((char *)&buf)[i] = *ptr;
+        }
+
+        res = (res << 23) || (res >> 41);
+        res ^= buf;
+    }
+
+    return res * UINT64_C(11400714819323198486);
+}
+
+static uint64_t new_hash(const char *str) { return hash_str(str); }
+
+#define BENCH_BUCKETS_POW 16
+
+// Buckets keys by the top bits of their hash the way hashmap_t does and
+// reports how many buckets end up used and the worst collision count
+static void bench_distribution(const char *name, uint64_t (*fn)(const char *)) {
+    static unsigned buckets[1 << BENCH_BUCKETS_POW];
+    size_t used = 0;
+    unsigned worst = 0;
+
+    memset(buckets, 0, sizeof(buckets));
+
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        uint64_t h = fn(bench_keys[i]);
+        unsigned *b = &buckets[h >> (64 - BENCH_BUCKETS_POW)];
+
+        used += *b == 0;
+        (*b)++;
+        worst = *b > worst ? *b : worst;
+    }
+
+    fprintf(stderr,
+            "%s: %zu/%d buckets used (ideal ~%.0f), worst bucket %u keys\n",
+            name, used, 1 << BENCH_BUCKETS_POW,
+            (1 << BENCH_BUCKETS_POW) *
+                (1.0 - pow_ratio(BENCH_KEYS, 1 << BENCH_BUCKETS_POW)),
+            worst);
+}
+
+// fn == NULL measures hash_bytes with the key lengths already known
+static void bench_throughput(const char *name, uint64_t (*fn)(const char *)) {
+    size_t bytes = 0;
+    uint64_t acc = 0;
+
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        bytes += bench_lens[i] * BENCH_ROUNDS;
+    }
+
+    clock_t start = clock();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int i = 0; i < BENCH_KEYS; i++) {
+            acc ^= fn != NULL ? fn(bench_keys[i])
+                              : hash_bytes(bench_keys[i], bench_lens[i]);
+        }
+    }
+    clock_t end = clock();
+
+    // Printing acc keeps the loop from being optimized away
+    fprintf(stderr, "%s: %.1f ns/key, %.0f MB/s (%llx)\n", name,
+            bench_ns(start, end, BENCH_KEYS * BENCH_ROUNDS),
+            bytes / ((double)(end - start) / CLOCKS_PER_SEC) / 1e6,
+            (unsigned long long)(acc & 0xf));
+}
+
+#define LATENCY_KEYS 500000
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Per put latency percentiles with and without incremental grows. Full
+// rehashes show up in the tail.
+static char *bench_hashmap_put_latency() {
+    const symbol_t **syms = malloc(LATENCY_KEYS * sizeof(const symbol_t *));
+    uint64_t *latencies = malloc(LATENCY_KEYS * sizeof(uint64_t));
+
+    test_assert("Memory allocated", syms != NULL && latencies != NULL);
+
+    for (int i = 0; i < LATENCY_KEYS; i++) {
+        char key[24];
+
+        sprintf(key, "latency%d", i);
+        syms[i] = symtab_intern(key);
+    }
+
+    for (int incremental = 0; incremental <= 1; incremental++) {
+        hashmap_t map;
+
+        test_assert("Hashmap is initialized", !hashmap_init(&map, sizeof(int)));
+        hashmap_set_incremental(&map, incremental);
+
+        for (int i = 0; i < LATENCY_KEYS; i++) {
+            uint64_t start = now_ns();
+            test_assert("put(#, #)", !hashmap_put_sym(&map, syms[i], &i));
+            latencies[i] = now_ns() - start;
+        }
+
+        qsort(latencies, LATENCY_KEYS, sizeof(uint64_t), compare_u64);
+
+        fprintf(stderr,
+                "hashmap put latency (%s): p50 %" PRIu64 " ns, p99 %" PRIu64
+                " ns, p99.9 %" PRIu64 " ns, max %" PRIu64 " ns\n",
+                incremental ? "incremental" : "full rehash",
+                latencies[LATENCY_KEYS / 2], latencies[LATENCY_KEYS / 100 * 99],
+                latencies[LATENCY_KEYS / 1000 * 999],
+                latencies[LATENCY_KEYS - 1]);
+
+        hashmap_destroy(&map);
+    }
+
+    free(latencies);
+    free(syms);
+
+    return NULL;
+}
+
+// Random order lookups in a table far larger than the cache, one at a time
+// and batched
+static char *bench_hashmap_get_many() {
+    const symbol_t **keys = malloc(LATENCY_KEYS * sizeof(const symbol_t *));
+    void **out = malloc(LATENCY_KEYS * sizeof(void *));
+    hashmap_t map;
+    hamt_t hamt;
+    int value = 1;
+
+    test_assert("Memory allocated", keys != NULL && out != NULL);
+    test_assert("Hashmap is initialized", !hashmap_init(&map, sizeof(int)));
+    test_assert("Hamt is initialized", !hamt_init(&hamt));
+
+    for (int i = 0; i < LATENCY_KEYS; i++) {
+        char key[24];
+
+        sprintf(key, "latency%d", i);
+        keys[i] = symtab_intern(key);
+
+        test_assert("put(#)", !hashmap_put_sym(&map, keys[i], &value));
+        test_assert("put(#)", !hamt_put_sym(&hamt, keys[i], &value));
+    }
+
+    srand(42);
+    for (int i = LATENCY_KEYS - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        const symbol_t *tmp = keys[i];
+
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+
+    clock_t start = clock();
+    for (int i = 0; i < LATENCY_KEYS; i++) {
+        out[i] = hashmap_get_sym(&map, keys[i]);
+    }
+    clock_t single_end = clock();
+    hashmap_get_many(&map, keys, LATENCY_KEYS, out);
+    clock_t many_end = clock();
+
+    for (int i = 0; i < LATENCY_KEYS; i++) {
+        out[i] = hamt_get_sym(&hamt, keys[i]);
+    }
+    clock_t hamt_single_end = clock();
+    hamt_get_many(&hamt, keys, LATENCY_KEYS, out);
+    clock_t hamt_many_end = clock();
+
+    for (int i = 0; i < LATENCY_KEYS; i++) {
+        test_assert("All keys found", out[i] == &value);
+    }
+
+    fprintf(stderr,
+            "%d random lookups: hashmap get %.1f ns/op, get_many %.1f ns/op, "
+            "hamt get %.1f ns/op, get_many %.1f ns/op\n",
+            LATENCY_KEYS, bench_ns(start, single_end, LATENCY_KEYS),
+            bench_ns(single_end, many_end, LATENCY_KEYS),
+            bench_ns(many_end, hamt_single_end, LATENCY_KEYS),
+            bench_ns(hamt_single_end, hamt_many_end, LATENCY_KEYS));
+
+    hamt_destroy(&hamt);
+    hashmap_destroy(&map);
+    free(out);
+    free(keys);
+
+    return NULL;
+}
+
+static char *bench_hash() {
+    bench_distribution("legacy hash", legacy_hash);
+    bench_distribution("hash_str", new_hash);
+    bench_throughput("legacy hash", legacy_hash);
+    bench_throughput("hash_str", new_hash);
+    bench_throughput("hash_bytes", NULL);
+
+    return NULL;
+}
+
 int main() {
     allocator = &default_allocator;
 
+    bench_init_keys();
+
+    test_run(test_hash_bytes);
+    test_run(bench_hash);
     test_run(test_hashmap_init_with_cap);
     test_run(test_hashmap_simple_get_and_put);
     test_run(test_hashmap_growth);
+    test_run(test_hashmap_small);
+    test_run(test_hashmap_incremental);
+    test_run(test_hashmap_get_many);
+    test_run(test_hashmap_remove);
+    test_run(test_hamt_share);
+    test_run(test_hamt_collisions);
+    test_run(bench_hashmap_put_get);
+    test_run(bench_hashmap_put_latency);
+    test_run(bench_hashmap_get_many);
 
     linalloc_t linalloc;
     linalloc_init(&linalloc);
@@ -106,6 +820,12 @@ int main() {
     test_run(test_hashmap_init_with_cap);
     test_run(test_hashmap_simple_get_and_put);
     test_run(test_hashmap_growth);
+    test_run(test_hashmap_small);
+    test_run(test_hashmap_incremental);
+    test_run(test_hashmap_get_many);
+    test_run(test_hashmap_remove);
+    test_run(test_hamt_share);
+    test_run(test_hamt_collisions);
 
     linalloc_destroy(&linalloc);
 
@@ -0,0 +1,94 @@
+#include <stdio.h>
+
+#include <data/idtable.h>
+
+#include <test.h>
+
+static char *test_bitset() {
+    bitset_t bitset;
+
+    test_assert("Bitset initialized", !bitset_init(&bitset, 10));
+    test_assert("test(3) == 0", !bitset_test(&bitset, 3));
+    test_assert("test(100000) == 0", !bitset_test(&bitset, 100000));
+
+    test_assert("set(3)", !bitset_set(&bitset, 3));
+    test_assert("set(64)", !bitset_set(&bitset, 64));
+    test_assert("set(100000) grows", !bitset_set(&bitset, 100000));
+
+    test_assert("test(3) == 1", bitset_test(&bitset, 3));
+    test_assert("test(4) == 0", !bitset_test(&bitset, 4));
+    test_assert("test(64) == 1", bitset_test(&bitset, 64));
+    test_assert("test(100000) == 1", bitset_test(&bitset, 100000));
+    test_assert("test(99999) == 0", !bitset_test(&bitset, 99999));
+
+    bitset_unset(&bitset, 64);
+    test_assert("test(64) == 0", !bitset_test(&bitset, 64));
+
+    bitset_clear(&bitset);
+    test_assert("test(3) == 0", !bitset_test(&bitset, 3));
+    test_assert("test(100000) == 0", !bitset_test(&bitset, 100000));
+
+    bitset_destroy(&bitset);
+
+    return NULL;
+}
+
+static char *test_idvec() {
+    idvec_t idvec;
+
+    test_assert("Idvec initialized", !idvec_init(&idvec, sizeof(long), 4));
+    test_assert("get_const(1000) == NULL",
+                idvec_get_const(&idvec, 1000) == NULL);
+
+    for (uint32_t id = 0; id < 1000; id += 7) {
+        long *elem = idvec_get_ref(&idvec, id);
+
+        test_assert("get_ref(#)", elem != NULL);
+        test_assert("Elements start zeroed", *elem == 0);
+
+        *elem = id * 2;
+    }
+
+    test_assert("get(994) == 1988",
+                *(const long *)idvec_get_const(&idvec, 994) == 1988);
+    test_assert("get(995) == 0",
+                *(const long *)idvec_get_const(&idvec, 995) == 0);
+
+    idvec_destroy(&idvec);
+
+    return NULL;
+}
+
+static char *test_idmap() {
+    idmap_t idmap;
+
+    test_assert("Idmap initialized", !idmap_init(&idmap, sizeof(int)));
+    test_assert("get(0) == NULL", idmap_get(&idmap, 0) == NULL);
+
+    for (int i = 0; i < 1000; i++) {
+        test_assert("put(#, #)", !idmap_put(&idmap, i * 3, &i));
+    }
+
+    int i42 = 42;
+
+    test_assert("put(0, 42)", !idmap_put(&idmap, 0, &i42));
+    test_assert("Replacing does not add", idmap.len == 1000);
+
+    test_assert("get(0) == 42", *(int *)idmap_get(&idmap, 0) == 42);
+    test_assert("get(2997) == 999", *(int *)idmap_get(&idmap, 2997) == 999);
+    test_assert("get(1) == NULL", idmap_get(&idmap, 1) == NULL);
+    test_assert("get(UINT32_MAX) == NULL",
+                idmap_get(&idmap, UINT32_MAX) == NULL);
+
+    idmap_destroy(&idmap);
+
+    return NULL;
+}
+
+int main() {
+    test_run(test_bitset);
+    test_run(test_idvec);
+    test_run(test_idmap);
+
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -39,8 +40,178 @@ static char *test_linalloc() {
     return NULL;
 }
 
+static char *test_linalloc_rewind() {
+    linalloc_t linalloc;
+
+    test_assert("Linalloc initialized", !linalloc_init(&linalloc));
+
+    char *kept = (char *)linalloc_alloc(&linalloc, 16);
+    strcpy(kept, "Hello test!");
+
+    linalloc_mark_t mark = linalloc_mark(&linalloc);
+    char *first = (char *)linalloc_alloc(&linalloc, 100);
+
+    // Spill over several blocks
+    for (int i = 0; i < 100; i++) {
+        test_assert("Linalloc alloc", linalloc_alloc(&linalloc, 4096) != NULL);
+    }
+
+    test_assert("Blocks were added", linalloc.blocks.vector.len > 1);
+
+    linalloc_rewind(&linalloc, mark);
+
+    test_assert("Blocks were released", linalloc.blocks.vector.len == 1);
+    test_assert("Mem before mark not changed", !strcmp(kept, "Hello test!"));
+    test_assert("Rewound mem is reused",
+                linalloc_alloc(&linalloc, 100) == first);
+
+    linalloc_destroy(&linalloc);
+
+    return NULL;
+}
+
+static char *test_linalloc_extend_before_mark() {
+    linalloc_t linalloc;
+
+    test_assert("Linalloc initialized", !linalloc_init(&linalloc));
+
+    char *kept = (char *)linalloc_alloc(&linalloc, 16);
+    strcpy(kept, "Hello test!");
+
+    linalloc_mark_t mark = linalloc_mark(&linalloc);
+
+    // Growing kept in place would leave it partly past the mark
+    char *grown = (char *)linalloc_realloc(&linalloc, kept, 256);
+    test_assert("Linalloc realloc", grown != NULL);
+    test_assert("Not grown in place", grown != kept);
+
+    linalloc_rewind(&linalloc, mark);
+
+    char *next = (char *)linalloc_alloc(&linalloc, 64);
+    test_assert("Linalloc alloc", next != NULL);
+    test_assert("No overlap with kept", next >= kept + 16 || next + 64 <= kept);
+    memset(next, 0, 64);
+    test_assert("Mem before mark not changed", !strcmp(kept, "Hello test!"));
+
+    linalloc_destroy(&linalloc);
+
+    return NULL;
+}
+
+static char *test_linalloc_realloc() {
+    linalloc_t linalloc;
+
+    test_assert("Linalloc initialized", !linalloc_init(&linalloc));
+
+    for (size_t align = 1; align <= 64; align *= 2) {
+        char *mem = (char *)linalloc_alloc_raw(&linalloc, 3, align);
+
+        test_assert("Raw alloc is aligned",
+                    ((uintptr_t)mem & (align - 1)) == 0);
+    }
+
+    char *mem = (char *)linalloc_alloc(&linalloc, 3);
+    test_assert("Alloc is aligned",
+                ((uintptr_t)mem & (LINALLOC_ALIGN - 1)) == 0);
+    memcpy(mem, "ab", 3);
+
+    test_assert("Last alloc grows in place",
+                linalloc_realloc(&linalloc, mem, 1000) == mem);
+
+    test_assert("Alloc after", linalloc_alloc(&linalloc, 16) != NULL);
+
+    char *moved = (char *)linalloc_realloc(&linalloc, mem, 2000);
+    test_assert("Older alloc is moved", moved != mem);
+    test_assert("Moved data is kept", !strcmp(moved, "ab"));
+
+    char *raw = (char *)linalloc_alloc_raw(&linalloc, 8, 8);
+    test_assert("Last raw alloc grows in place",
+                linalloc_realloc_raw(&linalloc, raw, 8, 64, 8) == raw);
+
+    linalloc_destroy(&linalloc);
+
+    return NULL;
+}
+
+#define FORK_THREADS 4
+#define FORK_ALLOCS 10000
+
+static void *fork_worker(void *data) {
+    linalloc_t *child = (linalloc_t *)data;
+    allocator_t allocator;
+
+    linalloc_set_thread(child);
+    linalloc_thread_allocator(&allocator);
+
+    char **ptrs = (char **)ALLOCATOR_ALLOC(&allocator,
+                                           FORK_ALLOCS * sizeof(char *));
+
+    for (int i = 0; i < FORK_ALLOCS; i++) {
+        ptrs[i] = ALLOCATOR_ALLOC(&allocator, 16);
+        sprintf(ptrs[i], "%d", i);
+    }
+
+    linalloc_set_thread(NULL);
+
+    return ptrs;
+}
+
+static char *test_linalloc_fork_join() {
+    linalloc_t parent;
+    linalloc_t children[FORK_THREADS];
+    pthread_t threads[FORK_THREADS];
+    char **ptrs[FORK_THREADS];
+
+    test_assert("Linalloc initialized", !linalloc_init(&parent));
+
+    for (int i = 0; i < FORK_THREADS; i++) {
+        test_assert("Fork", !linalloc_fork(&parent, &children[i]));
+        test_assert("Thread started",
+                    !pthread_create(&threads[i], NULL, fork_worker,
+                                    &children[i]));
+    }
+
+    for (int i = 0; i < FORK_THREADS; i++) {
+        test_assert("Thread joined",
+                    !pthread_join(threads[i], (void **)&ptrs[i]));
+        test_assert("Join", !linalloc_join(&parent, &children[i]));
+    }
+
+    test_assert("Parent adopted the blocks", parent.adopted.vector.len >= 4);
+
+    for (int i = 0; i < FORK_THREADS; i++) {
+        char expected[16];
+
+        for (int j = 0; j < FORK_ALLOCS; j += 777) {
+            sprintf(expected, "%d", j);
+            test_assert("Mem not changed", !strcmp(ptrs[i][j], expected));
+        }
+    }
+
+    linalloc_destroy(&parent);
+
+    return NULL;
+}
+
+// The main thread never calls linalloc_set_thread
+static char *test_linalloc_thread_unset() {
+    allocator_t allocator;
+
+    linalloc_thread_allocator(&allocator);
+
+    test_assert("No linalloc set", linalloc_thread() == NULL);
+    test_assert("Alloc fails", ALLOCATOR_ALLOC(&allocator, 16) == NULL);
+
+    return NULL;
+}
+
 int main() {
     test_run(test_linalloc);
+    test_run(test_linalloc_rewind);
+    test_run(test_linalloc_extend_before_mark);
+    test_run(test_linalloc_realloc);
+    test_run(test_linalloc_fork_join);
+    test_run(test_linalloc_thread_unset);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,260 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ast.h>
+#include <data/linalloc.h>
+#include <data/pool.h>
+#include <data/vector.h>
+#include <lexer.h>
+#include <parser.h>
+#include <scanner.h>
+#include <token_stream.h>
+
+#include <test.h>
+
+#define MODULES 64
+
+static const char *SOURCES[] = {
+    "main = putStrLn (show (f 3))\n"
+    "\n"
+    "f x = x * 2\n",
+
+    "module Fib where\n"
+    "fib n = if n < 2 then n else fib (n - 1) + fib (n - 2)\n",
+
+    "g x = let { x = 1; y = x + 2 }\n"
+    "      in y * x\n"
+    "h a b = a ++ \"str\" ++ b\n",
+
+    "main = do\n"
+    "    let n = 10\n"
+    "    print (sum n (n + 1))\n",
+};
+
+#define SOURCE_COUNT (sizeof(SOURCES) / sizeof(SOURCES[0]))
+
+// Token texts after layout, separated by spaces, inserted ones included
+static char *layout_of(const char *src, char *buf, size_t size) {
+    source_t source;
+    token_stream_t tokens;
+    size_t len = 0;
+
+    source_init_str(&source, src, strlen(src));
+    token_stream_init(&tokens, &default_allocator);
+
+    if (token_stream_scan(&tokens, &source) == -1 ||
+        token_stream_layout(&tokens) == -1) {
+        return NULL;
+    }
+
+    buf[0] = '\0';
+
+    for (size_t i = 0; i + 1 < tokens.len && len < size; ++i) {
+        if (tokens.lens[i] == 0) {
+            len += snprintf(buf + len, size - len, "%s%c", i ? " " : "",
+                            tokens.kinds[i]);
+        } else {
+            len += snprintf(buf + len, size - len, "%s%.*s", i ? " " : "",
+                            (int)tokens.lens[i],
+                            tokens.text + tokens.offsets[i]);
+        }
+    }
+
+    token_stream_destroy(&tokens);
+
+    return buf;
+}
+
+static char *test_layout() {
+    char buf[256];
+
+    test_assert("Blocks and lines",
+                !strcmp(layout_of("f x = y\n"
+                                  "  where\n"
+                                  "    y = 1\n"
+                                  "    z = 2\n"
+                                  "g = do\n"
+                                  "  a\n"
+                                  "    b\n"
+                                  "  c\n",
+                                  buf, sizeof(buf)),
+                        "{ f x = y where { y = 1 ; z = 2 } ; "
+                        "g = do { a b ; c } }"));
+    test_assert("Explicit braces",
+                !strcmp(layout_of("x = let { a = 1;\n"
+                                  "b = 2 } in a\n",
+                                  buf, sizeof(buf)),
+                        "{ x = let { a = 1 ; b = 2 } in a }"));
+    test_assert("Empty block",
+                !strcmp(layout_of("module M where\n", buf, sizeof(buf)),
+                        "module M where { }"));
+    test_assert("in closes let",
+                !strcmp(layout_of("x = let y = 1 in y\n", buf, sizeof(buf)),
+                        "{ x = let { y = 1 } in y }"));
+    test_assert("Brackets and if close blocks",
+                !strcmp(layout_of("x = (do a) + if b then do c else d\n",
+                                  buf, sizeof(buf)),
+                        "{ x = ( do { a } ) + if b then do { c } else d }"));
+
+    return NULL;
+}
+
+// Lexes and parses one module with state of its own, returning the printed
+// AST or NULL if anything failed
+static char *parse_module(const char *src) {
+    lexer_t lexer;
+    token_stream_t tokens;
+    parser_t parser;
+    linalloc_t linalloc;
+    allocator_t allocator;
+    ast_t ast;
+    char *text = NULL;
+    size_t size;
+
+    if (lexer_init_str(&lexer, src) == -1) {
+        return NULL;
+    }
+
+    token_stream_init(&tokens, &default_allocator);
+    int lexed = token_stream_flex(&tokens, &lexer);
+    lexer_destroy(&lexer);
+
+    if (lexed != -1) {
+        lexed = token_stream_layout(&tokens);
+    }
+
+    linalloc_init(&linalloc);
+    linalloc_allocator(&linalloc, &allocator);
+    parser_init(&parser);
+    parser_set_arena(&parser, &linalloc);
+
+    if (lexed != -1 &&
+        parser_parse(&parser, &tokens, &ast, &allocator) != -1) {
+        FILE *fp = open_memstream(&text, &size);
+
+        if (fp != NULL) {
+            ast_print(&ast, fp);
+            fclose(fp);
+        }
+
+        ast_destroy(&ast, &allocator);
+    }
+
+    parser_destroy(&parser);
+    linalloc_destroy(&linalloc);
+    token_stream_destroy(&tokens);
+
+    return text;
+}
+
+// What parser_parse returns for src, lexed and laid out without errors. A
+// failed parse leaves its partial AST in the arena.
+static int parse_result(const char *src) {
+    lexer_t lexer;
+    token_stream_t tokens;
+    parser_t parser;
+    linalloc_t linalloc;
+    allocator_t allocator;
+    ast_t ast;
+    int res = -2;
+
+    if (lexer_init_str(&lexer, src) == -1) {
+        return res;
+    }
+
+    token_stream_init(&tokens, &default_allocator);
+    int lexed = token_stream_flex(&tokens, &lexer);
+    lexer_destroy(&lexer);
+
+    if (lexed != -1 && token_stream_layout(&tokens) != -1) {
+        linalloc_init(&linalloc);
+        linalloc_allocator(&linalloc, &allocator);
+        parser_init(&parser);
+        parser_set_arena(&parser, &linalloc);
+
+        res = parser_parse(&parser, &tokens, &ast, &allocator);
+
+        parser_destroy(&parser);
+        linalloc_destroy(&linalloc);
+    }
+
+    token_stream_destroy(&tokens);
+
+    return res;
+}
+
+// A block element that does not parse fails the whole parse instead of
+// ending the block early
+static char *test_parse_errors() {
+    test_assert("Declaration after a bad one",
+                parse_result("module Main where\n"
+                             "\n"
+                             "x = 1\n"
+                             "Foo = 2\n") == -1);
+    test_assert("Unsupported lambda",
+                parse_result("h = \\a b -> a ++ \"str\" ++ b\n") == -1);
+    test_assert("Unsupported list in do",
+                parse_result("main = do\n"
+                             "    let n = 10\n"
+                             "    print (sum [1, 2, n])\n") == -1);
+    test_assert("Good module", parse_result("x = 1\ny = x\n") == 0);
+
+    return NULL;
+}
+
+static void parse_module_at(void *elem, size_t index, void *arg) {
+    char **texts = arg;
+
+    texts[index] = parse_module(*(const char **)elem);
+}
+
+// Modules parsed on several threads at once come out the same as one at a
+// time, with nothing shared but the symbol table
+static char *test_parse_concurrently() {
+    vector_t /* const char * */ modules;
+    char *expected[SOURCE_COUNT];
+    char *texts[MODULES] = {NULL};
+    pool_t pool;
+
+    for (size_t i = 0; i < SOURCE_COUNT; ++i) {
+        expected[i] = parse_module(SOURCES[i]);
+        test_assert("Module is parsed", expected[i] != NULL);
+    }
+
+    test_assert("Vector is initialized",
+                !vector_init(&modules, sizeof(const char *)));
+
+    for (size_t i = 0; i < MODULES; ++i) {
+        test_assert("Module is added",
+                    vector_push_back(&modules, &SOURCES[i % SOURCE_COUNT]));
+    }
+
+    test_assert("Pool is initialized", !pool_init(&pool, 4));
+    pool_parallel_for(&pool, &modules, 1, parse_module_at, texts);
+    pool_destroy(&pool);
+
+    for (size_t i = 0; i < MODULES; ++i) {
+        test_assert("Module is parsed", texts[i] != NULL);
+        test_assert("Same AST", !strcmp(texts[i], expected[i % SOURCE_COUNT]));
+        free(texts[i]);
+    }
+
+    for (size_t i = 0; i < SOURCE_COUNT; ++i) {
+        free(expected[i]);
+    }
+
+    vector_destroy(&modules);
+
+    return NULL;
+}
+
+int main() {
+    test_run(test_layout);
+    test_run(test_parse_errors);
+    test_run(test_parse_concurrently);
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <data/pool.h>
+#include <data/vector.h>
+#include <data/wsdeque.h>
+
+#include <test.h>
+
+#define DEQUE_ITEMS 200000
+#define DEQUE_THIEVES 3
+
+static int taken[DEQUE_ITEMS];
+static int items[DEQUE_ITEMS];
+
+typedef struct thief_ {
+    wsdeque_t *deque;
+    int *done;
+    long stolen;
+} thief_t;
+
+static void take(void *item) {
+    __atomic_add_fetch(&taken[(int *)item - items], 1, __ATOMIC_RELAXED);
+}
+
+static void *thief_main(void *data) {
+    thief_t *thief = data;
+
+    while (!__atomic_load_n(thief->done, __ATOMIC_ACQUIRE)) {
+        void *item = wsdeque_steal(thief->deque);
+
+        if (item != NULL) {
+            take(item);
+            thief->stolen++;
+        }
+    }
+
+    return NULL;
+}
+
+// The owner pushes everything, popping every third push, while thieves
+// steal. Each item has to be taken exactly once.
+static char *test_wsdeque_contention() {
+    wsdeque_t deque;
+    pthread_t threads[DEQUE_THIEVES];
+    thief_t thieves[DEQUE_THIEVES];
+    int done = 0;
+
+    test_assert("Deque is initialized", !wsdeque_init(&deque));
+    test_assert("pop() on empty == NULL", wsdeque_pop(&deque) == NULL);
+    test_assert("steal() on empty == NULL", wsdeque_steal(&deque) == NULL);
+
+    for (int t = 0; t < DEQUE_THIEVES; t++) {
+        thieves[t] = (thief_t){.deque = &deque, .done = &done, .stolen = 0};
+
+        test_assert("Thread started", !pthread_create(&threads[t], NULL,
+                                                      thief_main, &thieves[t]));
+    }
+
+    for (int i = 0; i < DEQUE_ITEMS; i++) {
+        test_assert("push(#)", !wsdeque_push(&deque, &items[i]));
+
+        if (i % 3 == 0) {
+            void *item = wsdeque_pop(&deque);
+
+            if (item != NULL) {
+                take(item);
+            }
+        }
+    }
+
+    void *item;
+    while ((item = wsdeque_pop(&deque)) != NULL) {
+        take(item);
+    }
+
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+
+    for (int t = 0; t < DEQUE_THIEVES; t++) {
+        test_assert("Thread joined", !pthread_join(threads[t], NULL));
+    }
+
+    for (int i = 0; i < DEQUE_ITEMS; i++) {
+        test_assert("Item taken once", taken[i] == 1);
+    }
+
+    test_assert("Deque grew", deque.array->prev != NULL);
+
+    wsdeque_destroy(&deque);
+
+    return NULL;
+}
+
+typedef struct fib_ {
+    pool_t *pool;
+    int n;
+    long result;
+} fib_t;
+
+static void fib(void *data) {
+    fib_t *f = data;
+
+    if (f->n < 2) {
+        f->result = f->n;
+        return;
+    }
+
+    fib_t a = {f->pool, f->n - 1, 0}, b = {f->pool, f->n - 2, 0};
+    pool_task_t task;
+
+    if (pool_fork(f->pool, &task, fib, &a)) {
+        f->result = -1;
+        return;
+    }
+    fib(&b);
+    pool_join(f->pool, &task);
+
+    f->result = a.result + b.result;
+}
+
+static char *test_pool_fork_join() {
+    pool_t pool;
+
+    test_assert("Pool is initialized", !pool_init(&pool, 4));
+
+    fib_t f = {&pool, 20, 0};
+    fib(&f);
+    test_assert("fib(20) == 6765", f.result == 6765);
+
+    pool_destroy(&pool);
+
+    return NULL;
+}
+
+static void add_index(void *elem, size_t index, void *arg) {
+    __atomic_add_fetch((long *)elem, (long)index + 1, __ATOMIC_RELAXED);
+}
+
+static char *test_pool_parallel_for() {
+    pool_t pool;
+    vector_t vector;
+    long zero = 0;
+
+    test_assert("Pool is initialized", !pool_init(&pool, 3));
+    test_assert("Vector is initialized", !vector_init(&vector, sizeof(long)));
+
+    for (int i = 0; i < 10000; i++) {
+        test_assert("push_back", vector_push_back(&vector, &zero) != NULL);
+    }
+
+    pool_parallel_for(&pool, &vector, 7, add_index, NULL);
+
+    for (size_t i = 0; i < vector.len; i++) {
+        test_assert("Every element visited once",
+                    *(const long *)vector_get_ref(&vector, i) == (long)i + 1);
+    }
+
+    vector_destroy(&vector);
+    pool_destroy(&pool);
+
+    return NULL;
+}
+
+// Scaling benchmark: a parallel for over elements that each cost about the
+// same as generating a small declaration
+
+#define BENCH_ELEMS 4096
+#define BENCH_WORK 20000
+
+static void bench_work(void *elem, size_t index, void *arg) {
+    unsigned long x = index;
+
+    for (int i = 0; i < BENCH_WORK; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+
+    *(unsigned long *)elem = x;
+}
+
+static double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char *bench_pool() {
+    vector_t vector;
+    unsigned long zero = 0;
+    double base = 0;
+
+    test_assert("Vector is initialized",
+                !vector_init(&vector, sizeof(unsigned long)));
+
+    for (int i = 0; i < BENCH_ELEMS; i++) {
+        test_assert("push_back", vector_push_back(&vector, &zero) != NULL);
+    }
+
+    size_t max = pool_cpu_count() * 2;
+
+    for (size_t len = 1; len <= max; len *= 2) {
+        pool_t pool;
+
+        test_assert("Pool is initialized", !pool_init(&pool, len));
+
+        double start = bench_now();
+        pool_parallel_for(&pool, &vector, POOL_DEFAULT_GRAIN, bench_work,
+                          NULL);
+        double elapsed = bench_now() - start;
+
+        if (len == 1) {
+            base = elapsed;
+        }
+
+        fprintf(stderr, "pool %2zu workers: %7.2f ms, speedup %.2fx\n", len,
+                elapsed * 1e3, base / elapsed);
+
+        pool_destroy(&pool);
+    }
+
+    vector_destroy(&vector);
+
+    return NULL;
+}
+
+int main() {
+    test_run(test_wsdeque_contention);
+    test_run(test_pool_fork_join);
+    test_run(test_pool_parallel_for);
+    test_run(bench_pool);
+
+    return 0;
+}
@@ -0,0 +1,329 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lexer.h>
+#include <scanner.h>
+#include <token_stream.h>
+
+#include <test.h>
+
+static const char TRICKY[] =
+    "module Main where\n"
+    "{- block\n   comment -} x = let { y = \"str\ning\" } in y\r\n"
+    "  -->a +-- b ... .. . :: : :+ () ( ) _x ~ `f` <- -> => == \\ | @\n\r"
+    "letter in' x'' 42abc -} cases 'a' \r x\n"
+    "  --\n"
+    "main = do { -- comment\n"
+    "  putStrLn \"hi\"; y <- getLine }\n"
+    "{- unterminated";
+
+static const char CHUNK[] =
+    "module Main where\n"
+    "\n"
+    "{- A block comment\n"
+    "   spanning lines -}\n"
+    "fib :: Int -> Int\n"
+    "fib n = if n < 2 then n else fib (n - 1) + fib (n - 2)\n"
+    "\n"
+    "-- Sum of a list, with a where clause\n"
+    "sumList xs = go 0 xs\n"
+    "  where go acc [] = acc\n"
+    "        go acc (y:ys) = go (acc + y) ys\n"
+    "\n"
+    "main = do\n"
+    "    let n = (read line) :: Int\n"
+    "    putStrLn (show (fib n) ++ \" is the answer\")\n"
+    "\n";
+
+// Like a module with thorough documentation, most of it is skipped
+static const char DOCS[] =
+    "{- | Looks up every name in the environment. The documentation goes on\n"
+    "   for a while, describing the arguments, what comes back and when it\n"
+    "   fails, with a few examples of calling it from other modules.\n"
+    "-}\n"
+    "lookupEverything :: Environment -> [Name] -> Maybe [Expression]\n"
+    "lookupEverything environment names =\n"
+    "                    traverse (lookupName environment) names  -- in order\n"
+    "                                                             -- or none\n"
+    "\n";
+
+// Long runs that cross vector boundaries, bytes over 0x7f and comments full
+// of dashes
+static const char WIDE[] =
+    "module Main where\n"
+    "identifierWithAVeryLongNameThatSpansVectors' = x''\n"
+    "                                                    y\n"
+    "\t \t  \t\t          \t                          z\n"
+    "{- - -- -\n- }\n\n\n  long                                 comment\n"
+    "---------------------------------------------------------------}\n"
+    "Conid0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOP_x 12345678901"
+    "234567890123456789012345678901234567890 caf\xc3\xa9 \x80\xff"
+    "{-\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n-";
+
+// Both lexers must agree on every token, its text and its column
+static char *check_same_tokens(const char *src) {
+    source_t source;
+    scanner_t scanner;
+    scanner_token_t tok;
+    lexer_t lexer;
+
+    source_init_str(&source, src, strlen(src));
+    scanner_init(&scanner, &source);
+    test_assert("Lexer is initialized", !lexer_init_str(&lexer, src));
+
+    for (;;) {
+        int flex_kind = lexer_next(&lexer);
+        token_t kind = scanner_next(&scanner, &tok);
+
+        test_assert("Same kind", kind == flex_kind);
+        if (kind == 0) {
+            break;
+        }
+
+        test_assert("Same length", tok.len == lexer_len(&lexer));
+        test_assert("Same text",
+                    !memcmp(src + tok.offset, lexer_text(&lexer), tok.len));
+        test_assert("Same column", scanner.tok_column ==
+                                       lexer_column(&lexer) - (int)tok.len);
+        test_assert("Same line", kind == TOK_STRING ||
+                                     scanner.tok_line == lexer_line(&lexer));
+    }
+
+    test_assert("Same line count", scanner.line == lexer_line(&lexer));
+
+    lexer_destroy(&lexer);
+    source_close(&source);
+
+    return NULL;
+}
+
+static char *test_scanner_matches_flex() {
+    char *res;
+
+    if ((res = check_same_tokens(TRICKY)) ||
+        (res = check_same_tokens(CHUNK)) ||
+        (res = check_same_tokens(WIDE))) {
+        return res;
+    }
+
+    source_t source;
+    scanner_t scanner;
+    scanner_token_t tok;
+
+    source_init_str(&source, "x  \"a\nb\" y", 10);
+    scanner_init(&scanner, &source);
+
+    test_assert("x", scanner_next(&scanner, &tok) == TOK_VARID);
+    test_assert("\"a\\nb\"", scanner_next(&scanner, &tok) == TOK_STRING);
+    test_assert("String is a slice", tok.offset == 3 && tok.len == 5);
+    test_assert("String starts on line 1", scanner.tok_line == 1);
+    test_assert("y", scanner_next(&scanner, &tok) == TOK_VARID);
+    test_assert("y is on line 2", scanner.tok_line == 2);
+    test_assert("End", scanner_next(&scanner, &tok) == 0);
+    test_assert("End again", scanner_next(&scanner, &tok) == 0);
+
+    return NULL;
+}
+
+// Every fast path gives the same tokens as the scalar code, also when the
+// source ends in the middle of a run
+static char *test_scanner_simd() {
+    source_t source;
+    scanner_t scalar, wide;
+    scanner_token_t tok, wide_tok;
+    size_t len = strlen(WIDE);
+
+    source_init_str(&source, WIDE, len);
+    scanner_init(&wide, &source);
+    scanner_simd_t best = wide.simd;
+
+    for (scanner_simd_t simd = SCANNER_SSE2; simd <= best; ++simd) {
+        for (size_t end = 0; end <= len; ++end) {
+            source_init_str(&source, WIDE, end);
+            scanner_init(&scalar, &source);
+            scanner_init(&wide, &source);
+            scalar.simd = SCANNER_SCALAR;
+            wide.simd = simd;
+
+            for (;;) {
+                token_t kind = scanner_next(&scalar, &tok);
+
+                test_assert("Same kind",
+                            scanner_next(&wide, &wide_tok) == kind);
+                test_assert("Same token", tok.offset == wide_tok.offset &&
+                                              tok.len == wide_tok.len);
+                test_assert("Same position",
+                            scalar.tok_line == wide.tok_line &&
+                                scalar.tok_column == wide.tok_column);
+
+                if (kind == 0) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Scanning and flex fill the same stream, only where the text lives differs
+static char *test_token_stream() {
+    token_stream_t scanned, flexed;
+    source_t source;
+
+    source_init_str(&source, TRICKY, strlen(TRICKY));
+
+    test_assert("Stream is initialized",
+                !token_stream_init(&scanned, &default_allocator));
+    test_assert("Stream is initialized",
+                !token_stream_init(&flexed, &default_allocator));
+
+    test_assert("Scanned", !token_stream_scan(&scanned, &source));
+
+    lexer_t lexer;
+
+    test_assert("Lexer is initialized", !lexer_init_str(&lexer, TRICKY));
+    test_assert("Lexed with flex", !token_stream_flex(&flexed, &lexer));
+    lexer_destroy(&lexer);
+
+    test_assert("Same length", scanned.len == flexed.len);
+    test_assert("Ends with the end token", scanned.kinds[scanned.len - 1] == 0);
+    test_assert("Text is not copied", scanned.text == TRICKY);
+
+    for (size_t i = 0; i < scanned.len; ++i) {
+        test_assert("Same kind", scanned.kinds[i] == flexed.kinds[i]);
+        test_assert("Same text",
+                    scanned.lens[i] == flexed.lens[i] &&
+                        !memcmp(scanned.text + scanned.offsets[i],
+                                flexed.text + flexed.offsets[i],
+                                scanned.lens[i]));
+        test_assert("Same line", scanned.lines[i] == flexed.lines[i]);
+        test_assert("Same column", scanned.columns[i] == flexed.columns[i]);
+    }
+
+    token_stream_destroy(&scanned);
+    token_stream_destroy(&flexed);
+
+    return NULL;
+}
+
+#define BENCH_BYTES ((size_t)32 << 20)
+#define BENCH_RUNS 3
+
+static double bench_mb_per_s(clock_t start, clock_t end, size_t bytes) {
+    return (double)bytes / (1 << 20) /
+           ((double)(end - start) / CLOCKS_PER_SEC);
+}
+
+// Scans a large file of chunk repeated, mapped from disk, with each fast path
+// the CPU has, then the same text with flex
+static char *bench_chunk(const char *chunk) {
+    size_t chunk_len = strlen(chunk);
+    size_t len = BENCH_BYTES / chunk_len * chunk_len;
+    char *text = malloc(len + 1);
+
+    test_assert("Text is allocated", text != NULL);
+
+    for (size_t i = 0; i < len; i += chunk_len) {
+        memcpy(text + i, chunk, chunk_len);
+    }
+    text[len] = '\0';
+
+    char path[] = "/tmp/schc-scanner-XXXXXX";
+    int fd = mkstemp(path);
+
+    test_assert("Temporary file is created", fd != -1);
+    test_assert("Temporary file is written", write(fd, text, len) == len);
+    close(fd);
+
+    source_t source;
+    scanner_t scanner;
+    scanner_token_t tok;
+    size_t tokens = 0;
+
+    test_assert("File is mapped", !source_open(&source, path));
+    test_assert("Whole file is mapped", source.len == len);
+
+    scanner_init(&scanner, &source);
+    scanner_simd_t best = scanner.simd;
+    static const char *names[] = {"scalar", "sse2", "avx2"};
+
+    for (scanner_simd_t simd = SCANNER_SCALAR; simd <= best; ++simd) {
+        double mb_per_s = 0;
+
+        // Best of a few, the first pass also faults the mapping in
+        for (int run = 0; run < BENCH_RUNS; ++run) {
+            size_t simd_tokens = 0;
+            clock_t start = clock();
+
+            scanner_init(&scanner, &source);
+            scanner.simd = simd;
+            while (scanner_next(&scanner, &tok) > 0) {
+                simd_tokens++;
+            }
+
+            clock_t end = clock();
+
+            test_assert("Same token count", !tokens || simd_tokens == tokens);
+            tokens = simd_tokens;
+
+            if (bench_mb_per_s(start, end, len) > mb_per_s) {
+                mb_per_s = bench_mb_per_s(start, end, len);
+            }
+        }
+
+        fprintf(stderr, "scanner (mmap, %s):%*s%zu tokens, %.1f MB/s\n",
+                names[simd], (int)(7 - strlen(names[simd])), "", tokens,
+                mb_per_s);
+    }
+
+    source_close(&source);
+    unlink(path);
+
+    size_t flex_tokens = 0;
+    lexer_t lexer;
+    clock_t start = clock();
+
+    test_assert("Lexer is initialized", !lexer_init_str(&lexer, text));
+    while (lexer_next(&lexer) > 0) {
+        flex_tokens++;
+    }
+    lexer_destroy(&lexer);
+
+    clock_t end = clock();
+
+    test_assert("Same token count", tokens == flex_tokens);
+
+    fprintf(stderr, "flex:                   %zu tokens, %.1f MB/s\n",
+            flex_tokens, bench_mb_per_s(start, end, len));
+
+    free(text);
+
+    return NULL;
+}
+
+static char *bench_scanner() {
+    char *res;
+
+    fprintf(stderr, "Mostly code:\n");
+    if ((res = bench_chunk(CHUNK))) {
+        return res;
+    }
+
+    fprintf(stderr, "Mostly comments and indentation:\n");
+    return bench_chunk(DOCS);
+}
+
+int main() {
+    test_run(test_scanner_matches_flex);
+    test_run(test_scanner_simd);
+    test_run(test_token_stream);
+    test_run(bench_scanner);
+
+    return 0;
+}
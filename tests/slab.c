@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <core.h>
+#include <data/slab.h>
+
+#include <test.h>
+
+static char *test_slab_pool() {
+    slab_pool_t pool;
+
+    test_assert("Pool initialized", !slab_pool_init(&pool));
+
+    char *a = (char *)slab_pool_alloc(&pool, sizeof(core_expr_t));
+    char *b = (char *)slab_pool_alloc(&pool, sizeof(core_expr_t));
+    char *c = (char *)slab_pool_alloc(&pool, 17);
+
+    test_assert("Alloc is aligned", ((uintptr_t)a & 15) == 0);
+    test_assert("Same size class is packed",
+                b == a + ((sizeof(core_expr_t) + 15) & ~15));
+    test_assert("Other size class goes elsewhere",
+                c < a || c >= b + sizeof(core_expr_t));
+
+    slab_pool_free(&pool, a);
+    test_assert("Freed node is reused",
+                slab_pool_alloc(&pool, sizeof(core_expr_t)) == a);
+
+    strcpy(c, "Hello test!");
+    char *grown = (char *)slab_pool_realloc(&pool, c, 30);
+    test_assert("Realloc within the class stays", grown == c);
+
+    grown = (char *)slab_pool_realloc(&pool, c, 100000);
+    test_assert("Large alloc", grown != NULL && grown != c);
+    test_assert("Moved data is kept", !strcmp(grown, "Hello test!"));
+    memset(grown, 0, 100000);
+
+    test_assert("Old slot was freed", slab_pool_alloc(&pool, 20) == c);
+
+    slab_pool_free(&pool, grown);
+
+    // Fill several slabs of one class
+    for (int i = 0; i < 10000; i++) {
+        test_assert("Alloc", slab_pool_alloc(&pool, 64) != NULL);
+    }
+
+    slab_pool_destroy(&pool);
+
+    return NULL;
+}
+
+#define BENCH_NODES 100000
+#define BENCH_ROUNDS 20
+
+static double bench_ns(clock_t start, clock_t end, size_t ops) {
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / ops;
+}
+
+// Builds and tears down a tree's worth of nodes, as coregen and core_destroy
+static char *bench_churn(const char *name, allocator_t *allocator) {
+    static void *nodes[BENCH_NODES];
+
+    clock_t start = clock();
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_NODES; i++) {
+            nodes[i] = ALLOCATOR_ALLOC(allocator, sizeof(core_expr_t));
+            test_assert("Alloc", nodes[i] != NULL);
+            ((core_expr_t *)nodes[i])->form = CORE_APPL;
+        }
+
+        for (int i = 0; i < BENCH_NODES; i++) {
+            ALLOCATOR_FREE(allocator, nodes[i]);
+        }
+    }
+
+    clock_t end = clock();
+
+    fprintf(stderr, "%-8s alloc+free: %.2f ns/node\n", name,
+            bench_ns(start, end, (size_t)BENCH_ROUNDS * BENCH_NODES));
+
+    return NULL;
+}
+
+static char *bench_slab_pool() {
+    char *res;
+    slab_pool_t pool;
+    allocator_t allocator;
+
+    test_assert("Pool initialized", !slab_pool_init(&pool));
+    slab_pool_allocator(&pool, &allocator);
+
+    if ((res = bench_churn("malloc", &default_allocator)) ||
+        (res = bench_churn("slab", &allocator))) {
+        return res;
+    }
+
+    slab_pool_destroy(&pool);
+
+    return NULL;
+}
+
+int main() {
+    test_run(test_slab_pool);
+    test_run(bench_slab_pool);
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <data/linalloc.h>
+#include <data/smallvec.h>
+#include <data/stack_define.h>
+#include <data/vector.h>
+#include <data/vector_define.h>
+
+#include <test.h>
+
+VECTOR_DEFINE(int, int, default)
+VECTOR_DEFINE(int_lin, int, linalloc)
+STACK_DEFINE(ptr, void *, linalloc)
+
+static char *test_vector_define() {
+    vector_int_t vector;
+
+    test_assert("Vector is initialized", !vector_int_init(&vector, NULL));
+    test_assert("Vector has length 0", vector.len == 0);
+
+    for (int i = 0; i < 1000; i++) {
+        test_assert("push_back(#)", !vector_int_push_back(&vector, i));
+    }
+
+    test_assert("Vector has length 1000", vector.len == 1000);
+    test_assert("Vector grew", vector.cap >= 1000);
+    test_assert("get(0) == 0", vector_int_get(&vector, 0) == 0);
+    test_assert("get(999) == 999", vector_int_get(&vector, 999) == 999);
+    test_assert("get_ref(1000) == NULL",
+                vector_int_get_ref(&vector, 1000) == NULL);
+
+    *vector_int_alloc_elem(&vector) = 42;
+    test_assert("get(1000) == 42", vector_int_get(&vector, 1000) == 42);
+
+    vector_int_destroy(&vector);
+
+    return NULL;
+}
+
+static char *test_stack_define() {
+    linalloc_t linalloc;
+    stack_ptr_t stack;
+    void *elem;
+    int a, b;
+
+    test_assert("Linalloc initialized", !linalloc_init(&linalloc));
+    test_assert("Stack is initialized", !stack_ptr_init(&stack, &linalloc));
+
+    test_assert("peek() == NULL", stack_ptr_peek(&stack) == NULL);
+    test_assert("pop() fails", stack_ptr_pop(&stack, &elem) == -1);
+
+    test_assert("push(&a)", !stack_ptr_push(&stack, &a));
+    test_assert("push(&b)", !stack_ptr_push(&stack, &b));
+    test_assert("peek() == &b", *stack_ptr_peek(&stack) == &b);
+
+    test_assert("pop() == &b", !stack_ptr_pop(&stack, &elem) && elem == &b);
+    test_assert("pop() == &a", !stack_ptr_pop(&stack, &elem) && elem == &a);
+    test_assert("Stack is empty", stack.vector.len == 0);
+
+    for (int i = 0; i < 100; i++) {
+        test_assert("push(&a)", !stack_ptr_push(&stack, &a));
+    }
+
+    test_assert("Stack grew in the linalloc", stack.vector.len == 100);
+
+    stack_ptr_destroy(&stack);
+    linalloc_destroy(&linalloc);
+
+    return NULL;
+}
+
+static char *test_smallvec() {
+    smallvec_t smallvec, moved;
+    int a, b, c, d;
+    int *ptrs[] = {&a, &b, &c, &d};
+
+    test_assert("Smallvec is initialized",
+                !smallvec_init(&smallvec, sizeof(int *)));
+    test_assert("Smallvec has 3 inline pointers", smallvec.cap == 3);
+
+    for (int i = 0; i < 3; i++) {
+        test_assert("push_back(&#)",
+                    smallvec_push_back(&smallvec, &ptrs[i]) != NULL);
+    }
+
+    test_assert("Elements are inline",
+                smallvec_get_mem(&smallvec) == smallvec.inline_mem);
+
+    // Inline elements must survive the smallvec being moved
+    memcpy(&moved, &smallvec, sizeof(smallvec_t));
+    test_assert("get(moved, 2) == &c",
+                *(int **)smallvec_get_ref(&moved, 2) == &c);
+
+    test_assert("push_back(&d)", smallvec_push_back(&moved, &ptrs[3]) != NULL);
+    test_assert("Elements spilled",
+                smallvec_get_mem(&moved) != moved.inline_mem);
+
+    for (int i = 0; i < 4; i++) {
+        test_assert("get(#) == &#",
+                    *(int **)smallvec_get_ref(&moved, i) == ptrs[i]);
+    }
+    test_assert("get(4) == NULL", smallvec_get_ref(&moved, 4) == NULL);
+
+    smallvec_destroy(&moved);
+
+    char big[64];
+
+    test_assert("Smallvec is initialized",
+                !smallvec_init(&smallvec, sizeof(big)));
+    test_assert("Big elements are never inline", smallvec.cap == 0);
+    test_assert("push_back(big)", smallvec_push_back(&smallvec, big) != NULL);
+    test_assert("Smallvec has length 1", smallvec.len == 1);
+
+    smallvec_destroy(&smallvec);
+
+    return NULL;
+}
+
+#define BENCH_ELEMS 1000000
+#define BENCH_ROUNDS 10
+
+static double bench_ns(clock_t start, clock_t end, size_t ops) {
+    return (double)(end - start) * 1e9 / CLOCKS_PER_SEC / ops;
+}
+
+static char *bench_generic(const char *name, allocator_t *allocator) {
+    clock_t start = clock();
+    long sum = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        vector_t vector;
+
+        test_assert("Vector is initialized",
+                    !vector_init_with_allocator(&vector, sizeof(int),
+                                                allocator));
+
+        for (int i = 0; i < BENCH_ELEMS; i++) {
+            test_assert("push_back", vector_push_back(&vector, &i) != NULL);
+        }
+
+        for (int i = 0; i < BENCH_ELEMS; i++) {
+            sum += *(const int *)vector_get_ref(&vector, i);
+        }
+
+        vector_destroy(&vector);
+    }
+
+    clock_t end = clock();
+
+    test_assert("Sum is right", sum == (long)BENCH_ROUNDS * BENCH_ELEMS *
+                                           (BENCH_ELEMS - 1) / 2);
+
+    fprintf(stderr, "vector_t %-8s push+get: %.2f ns/elem\n", name,
+            bench_ns(start, end, (size_t)BENCH_ROUNDS * BENCH_ELEMS));
+
+    return NULL;
+}
+
+static char *bench_vector() {
+    char *res;
+    linalloc_t linalloc;
+    allocator_t linalloc_alloc;
+
+    test_assert("Linalloc initialized", !linalloc_init(&linalloc));
+    linalloc_allocator(&linalloc, &linalloc_alloc);
+
+    if ((res = bench_generic("default", &default_allocator)) ||
+        (res = bench_generic("linalloc", &linalloc_alloc))) {
+        return res;
+    }
+
+    clock_t start = clock();
+    long sum = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        vector_int_t vector;
+
+        test_assert("Vector is initialized", !vector_int_init(&vector, NULL));
+
+        for (int i = 0; i < BENCH_ELEMS; i++) {
+            test_assert("push_back", !vector_int_push_back(&vector, i));
+        }
+
+        for (int i = 0; i < BENCH_ELEMS; i++) {
+            sum += vector_int_get(&vector, i);
+        }
+
+        vector_int_destroy(&vector);
+    }
+
+    clock_t mid = clock();
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        vector_int_lin_t vector;
+
+        test_assert("Vector is initialized",
+                    !vector_int_lin_init(&vector, &linalloc));
+
+        for (int i = 0; i < BENCH_ELEMS; i++) {
+            test_assert("push_back", !vector_int_lin_push_back(&vector, i));
+        }
+
+        for (int i = 0; i < BENCH_ELEMS; i++) {
+            sum += vector_int_lin_get(&vector, i);
+        }
+
+        vector_int_lin_destroy(&vector);
+    }
+
+    clock_t end = clock();
+
+    test_assert("Sum is right", sum == (long)2 * BENCH_ROUNDS * BENCH_ELEMS *
+                                           (BENCH_ELEMS - 1) / 2);
+
+    fprintf(stderr, "VECTOR_DEFINE default  push+get: %.2f ns/elem\n",
+            bench_ns(start, mid, (size_t)BENCH_ROUNDS * BENCH_ELEMS));
+    fprintf(stderr, "VECTOR_DEFINE linalloc push+get: %.2f ns/elem\n",
+            bench_ns(mid, end, (size_t)BENCH_ROUNDS * BENCH_ELEMS));
+
+    linalloc_destroy(&linalloc);
+
+    return NULL;
+}
+
+int main() {
+    test_run(test_vector_define);
+    test_run(test_stack_define);
+    test_run(test_smallvec);
+    test_run(bench_vector);
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <data/hashmap.h>
+#include <data/vmarena.h>
+
+#include <test.h>
+
+static char *test_vmarena() {
+    vmarena_t vmarena;
+
+    char test_str[16] = "Hello test!";
+    char *ptrs[100];
+
+    test_assert("Vmarena initialized",
+                !vmarena_init(&vmarena, 0, VMARENA_NONE));
+    test_assert("Nothing committed", vmarena.committed == 0);
+
+    // Enough to commit well past the first chunk
+    for (int i = 0; i < 100; i++) {
+        char *mem = (char *)vmarena_alloc(&vmarena, 65536 + i);
+
+        test_assert("Vmarena alloc", mem != NULL);
+        test_assert("Vmarena alloc is aligned",
+                    ((uintptr_t)mem & (VMARENA_ALIGN - 1)) == 0);
+
+        memcpy(mem, test_str, sizeof(test_str));
+        ptrs[i] = mem;
+    }
+
+    test_assert("Pages committed on demand",
+                vmarena.committed >= vmarena.used &&
+                    vmarena.committed < vmarena.reserved);
+
+    for (int i = 0; i < 100; i++) {
+        test_assert("Mem not changed", !strcmp(ptrs[i], test_str));
+    }
+
+    char *last = ptrs[99];
+    test_assert("Last alloc grows in place",
+                vmarena_realloc(&vmarena, last, 1 << 24) == last);
+    test_assert("Grown data is kept", !strcmp(last, test_str));
+
+    char *moved = (char *)vmarena_realloc(&vmarena, ptrs[0], 1 << 20);
+    test_assert("Older alloc is moved", moved != ptrs[0]);
+    test_assert("Moved data is kept", !strcmp(moved, test_str));
+
+    vmarena_destroy(&vmarena);
+
+    return NULL;
+}
+
+static char *test_vmarena_allocator() {
+    vmarena_t vmarena;
+    allocator_t allocator;
+    hashmap_t map;
+
+    test_assert("Vmarena initialized",
+                !vmarena_init(&vmarena, 1 << 26, VMARENA_HUGEPAGES));
+    vmarena_allocator(&vmarena, &allocator);
+
+    test_assert("Hashmap is initialized",
+                !hashmap_init_with_cap_and_allocator(&map, sizeof(int), 0,
+                                                     &allocator));
+
+    for (int i = 0; i < 10000; i++) {
+        char key[10];
+
+        sprintf(key, "v%d", i);
+
+        test_assert("put(v#, #)", !hashmap_put(&map, key, &i));
+    }
+
+    test_assert("get(v1337) == 1337",
+                *((int *)hashmap_get(&map, "v1337")) == 1337);
+
+    hashmap_destroy(&map);
+    vmarena_destroy(&vmarena);
+
+    return NULL;
+}
+
+int main() {
+    test_run(test_vmarena);
+    test_run(test_vmarena_allocator);
+
+    return 0;
+}